@@ -0,0 +1,125 @@
+#include "clipper.hh"
+
+#include <utility>
+
+using namespace kuro;
+
+enum ClipPlane {
+  CLIP_NEAR = 0,
+  CLIP_FAR,
+  CLIP_LEFT,
+  CLIP_RIGHT,
+  CLIP_BOTTOM,
+  CLIP_TOP,
+  CLIP_PLANE_NUM,
+};
+
+/*
+ * The signed distance to the plane, >= 0 is inside
+ *
+ * The projection matrix maps the visible points to negative w
+ * (see GetProjectionMatrix()), i.e. the view volume is
+ * w <= x, y, z <= -w
+ * and the near plane is z == w(NDC z = 1).
+ */
+static float GetDistance(Vec4f const &p, int plane, float band) noexcept
+{
+  const float w = -p.w();
+  switch (plane) {
+    case CLIP_NEAR: return p.z() + w;
+    case CLIP_FAR: return w - p.z();
+    case CLIP_LEFT: return p.x() + band * w;
+    case CLIP_RIGHT: return band * w - p.x();
+    case CLIP_BOTTOM: return p.y() + band * w;
+    case CLIP_TOP: return band * w - p.y();
+  }
+  return 0;
+}
+
+/*
+ * Bit i is set if the point is out of plane i
+ */
+static int GetOutCode(Vec4f const &p, float band) noexcept
+{
+  int code = 0;
+  for (int plane = 0; plane < CLIP_PLANE_NUM; ++plane) {
+    if (GetDistance(p, plane, band) < 0) code |= 1 << plane;
+  }
+  return code;
+}
+
+namespace kuro {
+
+FragmentContext LerpFragmentContext(FragmentContext const &a,
+                                    FragmentContext const &b, float t,
+                                    int varying_num) noexcept
+{
+  FragmentContext ret;
+  ret.clip_pos = a.clip_pos + (b.clip_pos - a.clip_pos) * t;
+  ret.intensity = a.intensity + (b.intensity - a.intensity) * t;
+  for (int i = 0; i < varying_num; ++i) {
+    ret.varyings[i] = a.varyings[i] + (b.varyings[i] - a.varyings[i]) * t;
+  }
+  return ret;
+}
+
+bool ClipTriangle(std::array<FragmentContext, 3> const &triangle,
+                  ClipPolygon &polygon, int varying_num) noexcept
+{
+  int frustum_code = ~0;
+  int guard_code = 0;
+  for (auto const &vertex : triangle) {
+    frustum_code &= GetOutCode(vertex.clip_pos, 1.f);
+    guard_code |= GetOutCode(vertex.clip_pos, KURO_GUARD_BAND);
+  }
+
+  // All vertexes are out of the same plane of view frustum
+  if (frustum_code != 0) return false;
+
+  polygon.num = 3;
+  for (int i = 0; i < 3; ++i) {
+    polygon.vertexes[i] = triangle[i];
+  }
+
+  if (guard_code == 0) return true;
+
+  /*
+   * Sutherland-Hodgman algorithm:
+   * Clip the polygon by the planes crossed one by one
+   */
+  ClipPolygon clipped;
+  ClipPolygon *in = &polygon;
+  ClipPolygon *out = &clipped;
+
+  for (int plane = 0; plane < CLIP_PLANE_NUM; ++plane) {
+    if ((guard_code & (1 << plane)) == 0) continue;
+
+    out->num = 0;
+    for (int i = 0; i < in->num; ++i) {
+      auto const &cur = in->vertexes[i];
+      auto const &next = in->vertexes[(i + 1) % in->num];
+      const float cur_dist = GetDistance(cur.clip_pos, plane, KURO_GUARD_BAND);
+      const float next_dist = GetDistance(next.clip_pos, plane, KURO_GUARD_BAND);
+
+      if (cur_dist >= 0) {
+        out->vertexes[out->num++] = cur;
+      }
+
+      // The edge crosses the plane
+      if ((cur_dist >= 0) != (next_dist >= 0)) {
+        const float t = cur_dist / (cur_dist - next_dist);
+        out->vertexes[out->num++] = LerpFragmentContext(cur, next, t, varying_num);
+      }
+    }
+
+    if (out->num < 3) return false;
+    std::swap(in, out);
+  }
+
+  if (in != &polygon) {
+    polygon = *in;
+  }
+  return true;
+}
+
+} // namespace kuro
@@ -0,0 +1,59 @@
+#ifndef KURO_GRAPHICS_CLIPPER_H__
+#define KURO_GRAPHICS_CLIPPER_H__
+
+#include <array>
+
+#include "kuro/graphics/shader_interface.hh"
+
+namespace kuro {
+
+/*
+ * The triangles in the guard band(NDC x, y in [-band, band]) are not
+ * clipped in x and y, the rasterizer just ignores the pixels out of screen.
+ *
+ * The screen coordinates must be less than 2^17 pixels(see DrawTriangle()),
+ * 8 is enough for the frame buffer whose size is less than 16384.
+ */
+#define KURO_GUARD_BAND 8.f
+
+/*
+ * The near, far and the guard band planes produce 3 + 6 vertexes at most
+ */
+#define KURO_CLIP_MAX_VERTEX 9
+
+struct ClipPolygon {
+  FragmentContext vertexes[KURO_CLIP_MAX_VERTEX];
+  int num = 0;
+};
+
+/**
+ * \brief Clip the triangle in homogeneous clip space(before perspective divide)
+ *
+ * The triangles are:
+ * - Out of the view frustum: discarded.
+ * - In the near, far plane and guard band: copied to polygon as is,
+ *   which is the common case.
+ * - Otherwise: clipped by Sutherland-Hodgman algorithm, the attributes
+ *   of new vertexes are interpolated linearly in clip space.
+ *
+ * The polygon is convex, it can be split to triangles in fan.
+ *
+ * \param varying_num The number of floats of varyings to interpolate
+ *
+ * \return
+ *  false -- The triangle is invisible
+ */
+bool ClipTriangle(std::array<FragmentContext, 3> const &triangle,
+                  ClipPolygon &polygon, int varying_num = 0) noexcept;
+
+/**
+ * \brief Linear interpolation of the attributes and the first
+ *        varying_num varyings, i.e. a + (b-a)*t
+ */
+FragmentContext LerpFragmentContext(FragmentContext const &a,
+                                    FragmentContext const &b, float t,
+                                    int varying_num = 0) noexcept;
+
+} // namespace kuro
+
+#endif
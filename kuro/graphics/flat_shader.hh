@@ -1,35 +1,69 @@
 #ifndef KURO_GRAPHICS_FLAT_SHADER_H__
 #define KURO_GRAPHICS_FLAT_SHADER_H__
 
+#include <algorithm>
+
 #include "shader_interface.hh"
 #include "kuro/img/frame_buffer.hh"
+#include "kuro/math/transform_kernel.hh"
 #include "kuro/util/log.hh"
 
 namespace kuro {
 
-class FlatShader : public ShaderInterface {
+class FlatShader final : public ShaderInterface {
  public:
-  FlatShader() = default;
+  /*
+   * The world position is read by the triangle setup only(the face normal),
+   * so it isn't interpolated
+   */
+  FlatShader() { world_pos_ = varyings.DeclareWorldPos(false); }
   ~FlatShader() override = default;
 
   FragmentContext VertexProcess(VertexContext &vctx) override
   {
     FragmentContext fctx;
-    fctx.world_pos = vctx.pos;
-  
-    // auto mvp = varying_projection_matrix * varying_view_matrix;
-    // auto mvp = varying_view_matrix; 
-    fctx.clip_pos = varying_model_matrix * EmbedVecf<4>(vctx.pos, 1);
+    fctx.clip_pos = *vctx.model_matrix * EmbedVecf<4>(vctx.pos, 1);
+    fctx.SetVarying(world_pos_, ClipVec<3>(fctx.clip_pos));
+
     fctx.clip_pos = varying_view_matrix * fctx.clip_pos;
-    fctx.clip_pos[2] -= 1.1;
     fctx.clip_pos = varying_projection_matrix * fctx.clip_pos;
-    
-    fctx.uv = vctx.uv;
-    fctx.world_normal = vctx.normal;
 
     return fctx;
   }
 
+  /*
+   * The positions are transformed by the MVP matrix combined once
+   * per draw call(VertexBatch::mvp_matrix)
+   * with TransformPoints() in blocks of VERTEX_BLOCK_SIZE vertexes,
+   * such that the outputs stay in the stack.
+   */
+  void VertexProcessBatch(VertexBatch const &batch,
+                          FragmentContext *fctxs) override
+  {
+    auto const &model = *batch.model_matrix;
+    auto const &mvp = *batch.mvp_matrix;
+
+    for (size_t begin = 0; begin < batch.num; begin += VERTEX_BLOCK_SIZE) {
+      const size_t num = std::min<size_t>(VERTEX_BLOCK_SIZE, batch.num - begin);
+      float const *xs = batch.xs + begin;
+      float const *ys = batch.ys + begin;
+      float const *zs = batch.zs + begin;
+
+      float clip[4][VERTEX_BLOCK_SIZE];
+      float world[3][VERTEX_BLOCK_SIZE];
+      float *const clip_rows[4] = { clip[0], clip[1], clip[2], clip[3] };
+      float *const world_rows[3] = { world[0], world[1], world[2] };
+      TransformPoints(mvp, xs, ys, zs, num, clip_rows, 4);
+      TransformPoints(model, xs, ys, zs, num, world_rows, 3);
+
+      for (size_t i = 0; i < num; ++i) {
+        auto &fctx = fctxs[begin + i];
+        fctx.clip_pos = Vec4f(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        fctx.SetVarying(world_pos_, Vec3f(world[0][i], world[1][i], world[2][i]));
+      }
+    }
+  }
+
   bool FragmentProcess(FragmentContext &fctx, FrameColor &color) override
   {
     color.r = fctx.intensity * 255;
@@ -38,7 +72,28 @@ class FlatShader : public ShaderInterface {
     return true;
   }
 
+  /*
+   * The color is same in the triangle,
+   * so the lighting is computed once per packet instead of per fragment
+   */
+  uint32_t FragmentProcessBatch(FragmentPacket const &packet,
+                                FrameColor *colors) override
+  {
+    const float intensity =
+        std::max(0.f, DotProduct(packet.face_normal, uniform_light_dir));
+    const uint8_t gray = intensity * 255;
+    const FrameColor color(gray, gray, gray);
+
+    for (int lane = 0; lane < KURO_FRAGMENT_PACKET_SIZE; ++lane) {
+      colors[lane] = color;
+    }
+    return packet.mask;
+  }
+
  private:
+  static constexpr size_t VERTEX_BLOCK_SIZE = 64;
+
+  int world_pos_;
 };
 
 } // namespace kuro
@@ -0,0 +1,134 @@
+#ifndef KURO_GRAPHICS_PHONG_SHADER_H__
+#define KURO_GRAPHICS_PHONG_SHADER_H__
+
+#include <math.h>
+#include <algorithm>
+
+#include "shader_interface.hh"
+#include "kuro/img/frame_buffer.hh"
+#include "kuro/math/transform_kernel.hh"
+
+namespace kuro {
+
+/**
+ * \brief Blinn-Phong shading per fragment
+ *
+ * The uv, normal and world position of vertex are the varyings,
+ * the interpolated normal makes the lighting smooth across the
+ * triangles instead of FlatShader.
+ * The uv selects the cell of a checkerboard, whose albedo is halved
+ * in the odd cells, it is disabled if uniform_checker_num is 0.
+ */
+class PhongShader : public ShaderInterface {
+ public:
+  Vec3f uniform_eye_pos; // 世界空间中相机的位置
+  float uniform_ambient = 0.1f;
+  float uniform_specular = 0.3f;
+  float uniform_shininess = 32;
+  int uniform_checker_num = 0; // The cells per unit of uv
+
+  PhongShader()
+  {
+    uv_ = varyings.Declare(VARYING_VEC2);
+    normal_ = varyings.Declare(VARYING_VEC3);
+    world_pos_ = varyings.DeclareWorldPos();
+  }
+
+  ~PhongShader() override = default;
+
+  FragmentContext VertexProcess(VertexContext &vctx) override
+  {
+    FragmentContext fctx;
+    const auto world_pos = *vctx.model_matrix * EmbedVecf<4>(vctx.pos, 1);
+    fctx.clip_pos = varying_projection_matrix * (varying_view_matrix * world_pos);
+
+    fctx.SetVarying(uv_, vctx.uv);
+    fctx.SetVarying(normal_, *vctx.normal_matrix * vctx.normal);
+    fctx.SetVarying(world_pos_, ClipVec<3>(world_pos));
+    return fctx;
+  }
+
+  /*
+   * Same with FlatShader::VertexProcessBatch(),
+   * the normals are transformed by TransformVectors() also
+   */
+  void VertexProcessBatch(VertexBatch const &batch,
+                          FragmentContext *fctxs) override
+  {
+    auto const &model = *batch.model_matrix;
+    auto const &mvp = *batch.mvp_matrix;
+
+    for (size_t begin = 0; begin < batch.num; begin += VERTEX_BLOCK_SIZE) {
+      const size_t num = std::min<size_t>(VERTEX_BLOCK_SIZE, batch.num - begin);
+
+      float clip[4][VERTEX_BLOCK_SIZE];
+      float world[3][VERTEX_BLOCK_SIZE];
+      float normal[3][VERTEX_BLOCK_SIZE];
+      float *const clip_rows[4] = { clip[0], clip[1], clip[2], clip[3] };
+      float *const world_rows[3] = { world[0], world[1], world[2] };
+      float *const normal_rows[3] = { normal[0], normal[1], normal[2] };
+      TransformPoints(mvp, batch.xs + begin, batch.ys + begin, batch.zs + begin,
+                      num, clip_rows, 4);
+      TransformPoints(model, batch.xs + begin, batch.ys + begin, batch.zs + begin,
+                      num, world_rows, 3);
+      TransformVectors(*batch.normal_matrix, batch.nxs + begin, batch.nys + begin,
+                       batch.nzs + begin, num, normal_rows);
+
+      for (size_t i = 0; i < num; ++i) {
+        auto &fctx = fctxs[begin + i];
+        fctx.clip_pos = Vec4f(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        fctx.SetVarying(uv_, Vec2f(batch.us[begin + i], batch.vs[begin + i]));
+        fctx.SetVarying(normal_, Vec3f(normal[0][i], normal[1][i], normal[2][i]));
+        fctx.SetVarying(world_pos_, Vec3f(world[0][i], world[1][i], world[2][i]));
+      }
+    }
+  }
+
+  /*
+   * uniform_light_dir is the direction the light travels in(same with FlatShader),
+   * the normal is outward.
+   */
+  bool FragmentProcess(FragmentContext &fctx, FrameColor &color) override
+  {
+    const auto normal = fctx.GetVarying<3>(normal_).Normalize();
+    const auto world_pos = fctx.GetVarying<3>(world_pos_);
+    const auto uv = fctx.GetVarying<2>(uv_);
+
+    const auto light = -uniform_light_dir;
+    const float diffuse = std::max(0.f, DotProduct(normal, light));
+
+    float specular = 0;
+    if (diffuse > 0) {
+      const auto half = (light + (uniform_eye_pos - world_pos).Normalize()).Normalize();
+      specular = powf(std::max(0.f, DotProduct(normal, half)), uniform_shininess);
+    }
+
+    float albedo = 1;
+    if (uniform_checker_num > 0) {
+      const int cell = (int)floorf(uv.x() * uniform_checker_num) +
+                       (int)floorf(uv.y() * uniform_checker_num);
+      if (cell & 1) albedo = 0.5f;
+    }
+
+    const float intensity = std::min(
+        1.f, albedo * (uniform_ambient + diffuse) + uniform_specular * specular);
+    const uint8_t gray = intensity * 255;
+    color = FrameColor(gray, gray, gray);
+    return true;
+  }
+
+  int GetUvOffset() const noexcept { return uv_; }
+  int GetNormalOffset() const noexcept { return normal_; }
+  int GetWorldPosOffset() const noexcept { return world_pos_; }
+
+ private:
+  static constexpr size_t VERTEX_BLOCK_SIZE = 64;
+
+  int uv_;
+  int normal_;
+  int world_pos_;
+};
+
+} // namespace kuro
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef KURO_GRAPHICS_RASTER_KERNEL_H__
+#define KURO_GRAPHICS_RASTER_KERNEL_H__
+
+#include <stdint.h>
+
+#if defined(__AVX2__) && !defined(KURO_DISABLE_SIMD)
+#include <immintrin.h>
+#define KURO_RASTER_AVX2 1
+#endif
+
+namespace kuro {
+
+/*
+ * The span is 8 horizontally adjacent pixels in a row.
+ *
+ * The value of edge function(or depth) of the lane is
+ * value(span) + offset[lane], where offset[lane] = lane * a.
+ * The edge functions are integers, and both the SIMD kernel and
+ * scalar kernel do the same float additions for depth,
+ * so they are bit-exact.
+ */
+#define KURO_SPAN_WIDTH 8
+
+/*
+ * The depth test passes if the new depth is
+ * - GREATER: closer than the buffered one
+ * - EQUAL: same as the buffered one(the shading pass after depth pre-pass)
+ */
+enum DepthFunc : uint8_t {
+  DEPTH_FUNC_GREATER = 0,
+  DEPTH_FUNC_EQUAL,
+};
+
+struct SpanOffsets {
+  alignas(32) int32_t edges[3][KURO_SPAN_WIDTH];
+  alignas(32) float depth[KURO_SPAN_WIDTH];
+};
+
+inline bool DepthTest(DepthFunc func, float depth, float old_depth) noexcept
+{
+  return func == DEPTH_FUNC_EQUAL ? depth == old_depth : depth > old_depth;
+}
+
+/**
+ * \brief Compute the coverage and depth test mask of a span
+ * \param e The edge function values of the first pixel
+ * \param z The depth of the first pixel
+ * \param zbuffer The depth buffer of the first pixel
+ * \param lane_num The number of valid pixels, [1, 8]
+ * \param out_depth The interpolated depth of each pixel
+ * \param func The depth test function
+ *
+ * \return
+ *  bit i is set if pixel i is in the triangle and passes the depth test
+ */
+inline uint32_t ComputeSpanMaskScalar(SpanOffsets const &offsets,
+                                      int32_t const e[3], float z,
+                                      float const *zbuffer, int lane_num,
+                                      float *out_depth,
+                                      DepthFunc func = DEPTH_FUNC_GREATER) noexcept
+{
+  uint32_t mask = 0;
+  for (int lane = 0; lane < lane_num; ++lane) {
+    const int32_t e0 = e[0] + offsets.edges[0][lane];
+    const int32_t e1 = e[1] + offsets.edges[1][lane];
+    const int32_t e2 = e[2] + offsets.edges[2][lane];
+    const float depth = z + offsets.depth[lane];
+    out_depth[lane] = depth;
+
+    if (e0 >= 0 && e1 >= 0 && e2 >= 0 && DepthTest(func, depth, zbuffer[lane])) {
+      mask |= 1u << lane;
+    }
+  }
+  return mask;
+}
+
+/**
+ * \brief Like ComputeSpanMaskScalar() but the span is known to be
+ *        in the triangle, only the depth test is done
+ */
+inline uint32_t ComputeDepthMaskScalar(SpanOffsets const &offsets, float z,
+                                       float const *zbuffer, int lane_num,
+                                       float *out_depth,
+                                       DepthFunc func = DEPTH_FUNC_GREATER) noexcept
+{
+  uint32_t mask = 0;
+  for (int lane = 0; lane < lane_num; ++lane) {
+    const float depth = z + offsets.depth[lane];
+    out_depth[lane] = depth;
+
+    if (DepthTest(func, depth, zbuffer[lane])) {
+      mask |= 1u << lane;
+    }
+  }
+  return mask;
+}
+
+#ifdef KURO_RASTER_AVX2
+
+inline __m256i GetValidLanes(int lane_num) noexcept
+{
+  const __m256i lane_idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(lane_num), lane_idx);
+}
+
+inline __m256 DepthTestAVX2(DepthFunc func, __m256 depth, __m256 old_depth) noexcept
+{
+  return func == DEPTH_FUNC_EQUAL ? _mm256_cmp_ps(depth, old_depth, _CMP_EQ_OQ)
+                                  : _mm256_cmp_ps(depth, old_depth, _CMP_GT_OQ);
+}
+
+inline uint32_t ComputeSpanMaskAVX2(SpanOffsets const &offsets,
+                                    int32_t const e[3], float z,
+                                    float const *zbuffer, int lane_num,
+                                    float *out_depth,
+                                    DepthFunc func = DEPTH_FUNC_GREATER) noexcept
+{
+  // The lanes out of the span must not touch the depth buffer
+  const __m256i valid = GetValidLanes(lane_num);
+  const __m256i minus_one = _mm256_set1_epi32(-1);
+
+  auto load_edge = [&offsets, e](int i) {
+    return _mm256_add_epi32(_mm256_set1_epi32(e[i]),
+        _mm256_load_si256((__m256i const*)offsets.edges[i]));
+  };
+
+  // e >= 0 <=> e > -1
+  __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(load_edge(0), minus_one),
+                                    _mm256_cmpgt_epi32(load_edge(1), minus_one));
+  inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(load_edge(2), minus_one));
+  inside = _mm256_and_si256(inside, valid);
+
+  const __m256 depth = _mm256_add_ps(_mm256_set1_ps(z), _mm256_load_ps(offsets.depth));
+  const __m256 old_depth = _mm256_maskload_ps(zbuffer, valid);
+
+  const __m256 pass = _mm256_and_ps(_mm256_castsi256_ps(inside),
+                                    DepthTestAVX2(func, depth, old_depth));
+
+  _mm256_storeu_ps(out_depth, depth);
+  return (uint32_t)_mm256_movemask_ps(pass);
+}
+
+inline uint32_t ComputeDepthMaskAVX2(SpanOffsets const &offsets, float z,
+                                     float const *zbuffer, int lane_num,
+                                     float *out_depth,
+                                     DepthFunc func = DEPTH_FUNC_GREATER) noexcept
+{
+  const __m256i valid = GetValidLanes(lane_num);
+  const __m256 depth = _mm256_add_ps(_mm256_set1_ps(z), _mm256_load_ps(offsets.depth));
+  const __m256 old_depth = _mm256_maskload_ps(zbuffer, valid);
+
+  __m256 pass = DepthTestAVX2(func, depth, old_depth);
+  pass = _mm256_and_ps(pass, _mm256_castsi256_ps(valid));
+
+  _mm256_storeu_ps(out_depth, depth);
+  return (uint32_t)_mm256_movemask_ps(pass);
+}
+
+#endif
+
+/**
+ * \brief Dispatch to the fastest kernel compiled in
+ *
+ * \note out_depth must be able to hold KURO_SPAN_WIDTH floats
+ */
+inline uint32_t ComputeSpanMask(SpanOffsets const &offsets,
+                                int32_t const e[3], float z,
+                                float const *zbuffer, int lane_num,
+                                float *out_depth,
+                                DepthFunc func = DEPTH_FUNC_GREATER) noexcept
+{
+#ifdef KURO_RASTER_AVX2
+  return ComputeSpanMaskAVX2(offsets, e, z, zbuffer, lane_num, out_depth, func);
+#else
+  return ComputeSpanMaskScalar(offsets, e, z, zbuffer, lane_num, out_depth, func);
+#endif
+}
+
+inline uint32_t ComputeDepthMask(SpanOffsets const &offsets, float z,
+                                 float const *zbuffer, int lane_num,
+                                 float *out_depth,
+                                 DepthFunc func = DEPTH_FUNC_GREATER) noexcept
+{
+#ifdef KURO_RASTER_AVX2
+  return ComputeDepthMaskAVX2(offsets, z, zbuffer, lane_num, out_depth, func);
+#else
+  return ComputeDepthMaskScalar(offsets, z, zbuffer, lane_num, out_depth, func);
+#endif
+}
+
+} // namespace kuro
+
+#endif
@@ -1,52 +1,154 @@
 #include "rasterizer.hh"
 
-#include "triangle.hh"
+#include "clipper.hh"
+
+#include <algorithm>
 
 using namespace kuro;
 
-Rasterizer::Rasterizer(Model *model, ShaderInterface *shader)
-  : model_(model)
-  , shader_(shader)
+/* The number of triangles assembled by one task in the vertex stage */
+static constexpr size_t TRIANGLE_CHUNK_SIZE = 256;
+
+/* The number of vertexes transformed by one task in the vertex stage */
+static constexpr size_t VERTEX_CHUNK_SIZE = 1024;
+
+constexpr int RasterizerBase::TILE_SIZE;
+
+RasterizerBase::RasterizerBase(int thread_num)
+  : pool_(new ThreadPool(thread_num))
+{
+  cull_.cull_mode = CULL_BACK;
+}
+
+RasterizerBase::~RasterizerBase() noexcept = default;
+
+void RasterizerBase::SetThreadNum(int thread_num)
+{
+  pool_.reset(new ThreadPool(thread_num));
+}
+
+void RasterizerBase::AddChunks(size_t draw_idx, Model const &model)
+{
+  auto const &vertex_buffer = model.vertex_buffer();
+  const auto vertex_num = vertex_buffer.GetVertexesNum();
+  const auto triangle_num = vertex_buffer.GetTrianglesNum();
+
+  vertex_outputs_[draw_idx].resize(vertex_num);
+  for (size_t begin = 0; begin < vertex_num; begin += VERTEX_CHUNK_SIZE) {
+    vertex_chunks_.push_back(
+        { draw_idx, begin, std::min(vertex_num, begin + VERTEX_CHUNK_SIZE) });
+  }
+
+  for (size_t begin = 0; begin < triangle_num; begin += TRIANGLE_CHUNK_SIZE) {
+    if (chunk_num_ == chunks_.size()) chunks_.emplace_back();
+
+    auto &chunk = chunks_[chunk_num_++];
+    chunk.draw_idx = draw_idx;
+    chunk.triangle_begin = begin;
+    chunk.triangle_end = std::min(triangle_num, begin + TRIANGLE_CHUNK_SIZE);
+    chunk.triangles.clear();
+    chunk.stats = CullStats();
+  }
+}
+
+void RasterizerBase::ClearChunks() noexcept
 {
+  chunk_num_ = 0;
+  vertex_chunks_.clear();
 }
 
-void Rasterizer::Render(FrameBuffer &frame_buffer)
+VertexBatch RasterizerBase::GetVertexBatch(VertexBuffer const &buffer,
+                                           VertexChunk const &chunk,
+                                           Matrix4x4f const *model_matrix,
+                                           Matrix3x3f const *normal_matrix,
+                                           Matrix4x4f const *mvp_matrix) noexcept
 {
-  frame_buffer.ClearAllPixel();
-  frame_buffer.ClearDepth();
+  const size_t begin = chunk.vertex_begin;
+  return {
+    chunk.vertex_end - begin,
+    buffer.GetStream(VERTEX_STREAM_X) + begin,
+    buffer.GetStream(VERTEX_STREAM_Y) + begin,
+    buffer.GetStream(VERTEX_STREAM_Z) + begin,
+    buffer.GetStream(VERTEX_STREAM_NX) + begin,
+    buffer.GetStream(VERTEX_STREAM_NY) + begin,
+    buffer.GetStream(VERTEX_STREAM_NZ) + begin,
+    buffer.GetStream(VERTEX_STREAM_U) + begin,
+    buffer.GetStream(VERTEX_STREAM_V) + begin,
+    model_matrix,
+    normal_matrix,
+    mvp_matrix,
+  };
+}
 
-  for (size_t i = 0; i < model_->GetFacesNum(); ++i) {
-    auto &face = model_->GetFace(i);
-    std::array<FragmentContext, 3> fctxs;
-    const auto polygon_vertex_num = face.size();
-    if (polygon_vertex_num < 3 || polygon_vertex_num > 4) {
-      fprintf(stderr, "Can't process polygon whose vertexes num less than 3 or "
-                      "greater than 4");
-      return;
+void RasterizerBase::ClipAndSetupTriangle(std::array<FragmentContext, 3> const &fctxs,
+                                          int w, int h,
+                                          VaryingLayout const &varyings,
+                                          FaceChunk &chunk) const
+{
+  auto &triangles = chunk.triangles;
+  auto &stats = chunk.stats;
+  stats.input_num++;
+
+  ClipPolygon polygon;
+  if (!ClipTriangle(fctxs, polygon, varyings.GetFloatNum())) {
+    stats.frustum_num++;
+    return;
+  }
+
+  for (int i = 1; i + 1 < polygon.num; ++i) {
+    triangles.emplace_back();
+    if (!SetupTriangle({ polygon.vertexes[0], polygon.vertexes[i], polygon.vertexes[i+1] },
+                       w, h, triangles.back(), cull_, &stats, &varyings)) {
+      triangles.pop_back();
     }
+  }
+}
 
-    int tri_vtxes[3] = {0, 1, 2};
-
-    int tri_num = 1;
-    if (polygon_vertex_num == 4) tri_num++;
-    for (; tri_num > 0; --tri_num) {
-      for (int i = 0; i < 3; ++i) {
-        auto &mesh = face[tri_vtxes[i]];
-        VertexContext vctx{
-            .pos = model_->GetVertex(mesh.vertex_idx),
-            .normal = model_->GetNormal(mesh.normal_idx),
-            .uv = ClipVec<2>(model_->GetTexture(mesh.uv_idx)),
-        };
-        fctxs[i] = shader_->VertexProcess(vctx);
-      }
+void RasterizerBase::AccumulateChunkStats() noexcept
+{
+  for (size_t i = 0; i < chunk_num_; ++i) {
+    stats_ += chunks_[i].stats;
+  }
+}
 
-      DrawTriangle(fctxs, shader_, frame_buffer);
+void RasterizerBase::BinTriangles(FrameBuffer const &frame_buffer)
+{
+  tile_cols_ = (frame_buffer.GetWidth() + TILE_SIZE - 1) / TILE_SIZE;
+  tile_rows_ = (frame_buffer.GetHeight() + TILE_SIZE - 1) / TILE_SIZE;
+  tile_bins_.resize(tile_cols_ * tile_rows_);
+
+  for (auto &bin : tile_bins_)
+    bin.clear();
+
+  for (size_t i = 0; i < chunk_num_; ++i) {
+    auto const &chunk = chunks_[i];
+    for (auto const &tri : chunk.triangles) {
+      const int tx0 = tri.bbmin.x() / TILE_SIZE;
+      const int ty0 = tri.bbmin.y() / TILE_SIZE;
+      const int tx1 = tri.bbmax.x() / TILE_SIZE;
+      const int ty1 = tri.bbmax.y() / TILE_SIZE;
 
-      if (polygon_vertex_num == 4) {
-        tri_vtxes[0] = 2;
-        tri_vtxes[1] = 3;
-        tri_vtxes[2] = 0;
+      for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+          tile_bins_[tx + ty * tile_cols_].push_back({ &tri, chunk.draw_idx });
+        }
       }
     }
   }
 }
+
+void RasterizerBase::GetTileRegion(size_t tile, FrameBuffer const &frame_buffer,
+                                   Vec2i &clip_min, Vec2i &clip_max) const noexcept
+{
+  const int tx = (int)tile % tile_cols_;
+  const int ty = (int)tile / tile_cols_;
+  clip_min = Vec2i(tx * TILE_SIZE, ty * TILE_SIZE);
+  clip_max = Vec2i(std::min(frame_buffer.GetWidth(), (tx + 1) * TILE_SIZE) - 1,
+                   std::min(frame_buffer.GetHeight(), (ty + 1) * TILE_SIZE) - 1);
+}
+
+namespace kuro {
+
+template class BasicRasterizer<ShaderInterface>;
+
+} // namespace kuro
@@ -1,36 +1,365 @@
 #ifndef KURO_RASTERIZER_H__
 #define KURO_RASTERIZER_H__
 
+#include <memory>
+#include <vector>
+
 #include "kuro/util/noncopyable.hh"
+#include "kuro/util/thread_pool.hh"
 #include "kuro/img/model.hh"
 #include "kuro/img/frame_buffer.hh"
 
 #include "shader_interface.hh"
+#include "triangle.hh"
 
 namespace kuro {
 
-class Rasterizer : public kanon::noncopyable {
+/**
+ * \brief The model drawn in the scene
+ *
+ * The shader must not depend on the draw call except the model matrix
+ * (passed by VertexContext::model_matrix and its normal matrix), since
+ * the draw calls are processed together.
+ * The materials(colors, textures) are the uniforms of shader,
+ * use different shaders for different materials.
+ */
+template <typename Shader>
+struct BasicDrawCall {
+  Model const *model = nullptr;
+  Matrix4x4f model_matrix = GetIdentityF<4>();
+  Shader *shader = nullptr;
+};
+
+/**
+ * \brief The stages of tile renderer independent of the shader type
+ *
+ * \see BasicRasterizer
+ */
+class RasterizerBase : public kanon::noncopyable {
+ public:
+  /* The Hi-Z tile is owned by the thread rasterizing the tile */
+  static constexpr int TILE_SIZE = KURO_HIZ_TILE_SIZE;
+
+  /**
+   * \param thread_num <= 0 means the hardware concurrency
+   */
+  explicit RasterizerBase(int thread_num = 0);
+  ~RasterizerBase() noexcept;
+
+  /**
+   * The triangles facing the side of cull mode are removed
+   * in the following Draw()(default: back faces in CCW winding)
+   */
+  void SetCullMode(CullMode cull_mode) noexcept { cull_.cull_mode = cull_mode; }
+  void SetFrontFace(FrontFace front_face) noexcept { cull_.front_face = front_face; }
+  CullState const &GetCullState() const noexcept { return cull_; }
+
+  /**
+   * Rasterize the triangles of a tile twice in Draw():
+   * write the depth only, then shade the pixels whose depth is equal,
+   * such that the fragments are shaded once per visible pixel
+   * instead of once per depth test passed.
+   *
+   * \warning
+   *  The fragments discarded by the shader still occlude the
+   *  others in the depth pass.
+   *  The models drawn in the different Draw() don't share the pre-pass,
+   *  draw them in one Draw() with draw calls.
+   */
+  void SetDepthPrePass(bool enable) noexcept { depth_pre_pass_ = enable; }
+  bool IsDepthPrePass() const noexcept { return depth_pre_pass_; }
+
+  /**
+   * The statistics are accumulated by Draw() and reset by Render()
+   */
+  CullStats const &GetCullStats() const noexcept { return stats_; }
+  void ResetCullStats() noexcept { stats_ = CullStats(); }
+
+  void SetThreadNum(int thread_num);
+  int GetThreadNum() const noexcept { return pool_->GetThreadNum(); }
+
+ protected:
+  /*
+   * The vertexes of vertex buffer in a draw call processed by one task
+   */
+  struct VertexChunk {
+    size_t draw_idx;
+    size_t vertex_begin;
+    size_t vertex_end;
+  };
+
+  /*
+   * The triangles of model in a draw call processed by one task
+   * and the triangles set up by them.
+   * The number of triangles set up is unknown until clipping.
+   */
+  struct FaceChunk {
+    size_t draw_idx;
+    size_t triangle_begin;
+    size_t triangle_end;
+    std::vector<TriangleSetup> triangles;
+    CullStats stats;
+  };
+
+  struct BinEntry {
+    TriangleSetup const *triangle;
+    size_t draw_idx;
+  };
+
+  /**
+   * \brief Split the triangles and vertexes of the model to chunks
+   *
+   * The outputs of vertex shader of the draw call are resized to
+   * the vertex buffer.
+   */
+  void AddChunks(size_t draw_idx, Model const &model);
+  void ClearChunks() noexcept;
+
+  static VertexBatch GetVertexBatch(VertexBuffer const &buffer,
+                                    VertexChunk const &chunk,
+                                    Matrix4x4f const *model_matrix,
+                                    Matrix3x3f const *normal_matrix,
+                                    Matrix4x4f const *mvp_matrix) noexcept;
+
+  /**
+   * \brief Clip, setup and cull the triangle, the result is appended to chunk
+   */
+  void ClipAndSetupTriangle(std::array<FragmentContext, 3> const &fctxs,
+                            int w, int h, VaryingLayout const &varyings,
+                            FaceChunk &chunk) const;
+
+  void AccumulateChunkStats() noexcept;
+  void BinTriangles(FrameBuffer const &frame_buffer);
+
+  /**
+   * \brief Get the region of tile in the frame buffer(inclusive)
+   */
+  void GetTileRegion(size_t tile, FrameBuffer const &frame_buffer,
+                     Vec2i &clip_min, Vec2i &clip_max) const noexcept;
+
+  std::unique_ptr<ThreadPool> pool_;
+
+  CullState cull_;
+  bool depth_pre_pass_ = false;
+  CullStats stats_;
+
+  /*
+   * The normal matrix and MVP matrix of every draw call,
+   * computed once per Draw() instead of per vertex batch
+   */
+  std::vector<Matrix3x3f> normal_matrices_;
+  std::vector<Matrix4x4f> mvp_matrices_;
+
+  /*
+   * The outputs of vertex shader of every draw call,
+   * indexed by the indexes of vertex buffer.
+   * The vertex shared by the triangles is transformed once per Draw().
+   */
+  std::vector<std::vector<FragmentContext>> vertex_outputs_;
+  std::vector<VertexChunk> vertex_chunks_;
+
+  /* The chunks are not destroyed to reuse the memory of triangles */
+  std::vector<FaceChunk> chunks_;
+  size_t chunk_num_ = 0;
+
+  int tile_cols_ = 0;
+  int tile_rows_ = 0;
+  /* The triangles overlapping the tile in submission order */
+  std::vector<std::vector<BinEntry>> tile_bins_;
+};
+
+/**
+ * \brief Sort-middle tile renderer
+ *
+ * 1. Vertex processing(parallel in vertex chunks of the vertex buffers),
+ *    clipping and triangle setup(parallel in face chunks of all draw calls)
+ * 2. Bin the triangles into the screen tiles they overlap
+ * 3. Rasterize and shade the tiles(parallel in tiles)
+ *
+ * Every tile owns its region of the color buffer and depth buffer
+ * and keeps the submission order of triangles, hence no locking
+ * is required and the image is same as the serial one.
+ *
+ * The Shader is a compile-time parameter, its VertexProcessBatch() and
+ * FragmentProcessBatch() are inlined into the pipeline if it is final.
+ * Rasterizer(i.e. BasicRasterizer<ShaderInterface>) calls them virtually,
+ * so the shader of each draw call can be selected at runtime.
+ *
+ * \warning
+ *  The methods of Shader are called in multiple threads, they must not modify the shader.
+ */
+template <typename Shader>
+class BasicRasterizer : public RasterizerBase {
  public:
-  Rasterizer() = default;
-  Rasterizer(Model *model, ShaderInterface *shader);
-  
-  ~Rasterizer() noexcept = default;
+  using DrawCall = BasicDrawCall<Shader>;
 
-  void Render(FrameBuffer &frame_buffer);
+  explicit BasicRasterizer(int thread_num = 0)
+    : RasterizerBase(thread_num)
+  {
+  }
+
+  BasicRasterizer(Model *model, Shader *shader, int thread_num = 0)
+    : RasterizerBase(thread_num)
+    , model_(model)
+    , shader_(shader)
+  {
+  }
+
+  /**
+   * Clear the frame buffer and draw the model
+   */
+  void Render(FrameBuffer &frame_buffer)
+  {
+    frame_buffer.ClearAllPixel();
+    frame_buffer.ClearDepth();
+    ResetCullStats();
+
+    Draw(*model_, frame_buffer);
+  }
+
+  /**
+   * Clear the frame buffer and draw the scene
+   */
+  void Render(std::vector<DrawCall> const &draws, FrameBuffer &frame_buffer)
+  {
+    frame_buffer.ClearAllPixel();
+    frame_buffer.ClearDepth();
+    ResetCullStats();
+
+    Draw(draws, frame_buffer);
+  }
+
+  /**
+   * Draw the model with the shader and its varying_model_matrix
+   * to the frame buffer without clearing it
+   */
+  void Draw(Model const &model, FrameBuffer &frame_buffer)
+  {
+    DrawCall draw;
+    draw.model = &model;
+    draw.model_matrix = shader_->varying_model_matrix;
+    draw.shader = shader_;
+
+    Draw(&draw, 1, frame_buffer);
+  }
+
+  /**
+   * Draw the scene to the frame buffer without clearing it
+   *
+   * The draw calls share one pass of pipeline, i.e. the triangles of
+   * all models are binned and rasterized together in the draw call order.
+   */
+  void Draw(DrawCall const *draws, size_t draw_num, FrameBuffer &frame_buffer)
+  {
+    ProcessVertexes(draws, draw_num, frame_buffer);
+
+    BinTriangles(frame_buffer);
+    RasterizeTiles(draws, frame_buffer);
+  }
+
+  void Draw(std::vector<DrawCall> const &draws, FrameBuffer &frame_buffer)
+  {
+    Draw(draws.data(), draws.size(), frame_buffer);
+  }
 
   Model *GetModel() noexcept { return model_; }
   Model const *GetModel() const noexcept { return model_; }
   void SetModel(Model *model) noexcept { model_ = model; }
-  
-  ShaderInterface const *GetShader() const noexcept { return shader_; }
-  ShaderInterface *GetShader() noexcept { return shader_; }
-  void SetShader(ShaderInterface *shader) noexcept { shader_ = shader; }
+
+  Shader const *GetShader() const noexcept { return shader_; }
+  Shader *GetShader() noexcept { return shader_; }
+  void SetShader(Shader *shader) noexcept { shader_ = shader; }
 
  private:
+  void ProcessVertexes(DrawCall const *draws, size_t draw_num,
+                       FrameBuffer const &frame_buffer);
+  void RasterizeTiles(DrawCall const *draws, FrameBuffer &frame_buffer);
+
   Model *model_ = nullptr;
-  ShaderInterface *shader_ = nullptr;
+  Shader *shader_ = nullptr;
 };
 
+template <typename Shader>
+void BasicRasterizer<Shader>::ProcessVertexes(DrawCall const *draws, size_t draw_num,
+                                              FrameBuffer const &frame_buffer)
+{
+  ClearChunks();
+  normal_matrices_.resize(draw_num);
+  mvp_matrices_.resize(draw_num);
+  vertex_outputs_.resize(draw_num);
+  for (size_t draw_idx = 0; draw_idx < draw_num; ++draw_idx) {
+    auto const &draw = draws[draw_idx];
+    AddChunks(draw_idx, *draw.model);
+    normal_matrices_[draw_idx] = GetNormalMatrix(draw.model_matrix);
+    mvp_matrices_[draw_idx] = draw.shader->varying_projection_matrix *
+                              draw.shader->varying_view_matrix * draw.model_matrix;
+  }
+
+  const int w = frame_buffer.GetWidth();
+  const int h = frame_buffer.GetHeight();
+
+  // 1. Transform the vertex buffers in batches
+  pool_->ParallelFor(vertex_chunks_.size(), [&](size_t chunk_idx) {
+    auto const &chunk = vertex_chunks_[chunk_idx];
+    auto const &draw = draws[chunk.draw_idx];
+
+    draw.shader->VertexProcessBatch(
+        GetVertexBatch(draw.model->vertex_buffer(), chunk, &draw.model_matrix,
+                       &normal_matrices_[chunk.draw_idx], &mvp_matrices_[chunk.draw_idx]),
+        vertex_outputs_[chunk.draw_idx].data() + chunk.vertex_begin);
+  });
+
+  // 2. Assemble the triangles from the transformed vertexes
+  pool_->ParallelFor(chunk_num_, [&](size_t chunk_idx) {
+    auto &chunk = chunks_[chunk_idx];
+    auto const &draw = draws[chunk.draw_idx];
+    auto const &indexes = draw.model->vertex_buffer().indexes();
+    auto const &fctxs = vertex_outputs_[chunk.draw_idx];
+
+    auto const &varyings = draw.shader->varyings;
+    for (size_t i = chunk.triangle_begin; i < chunk.triangle_end; ++i) {
+      uint32_t const *corners = &indexes[3 * i];
+      ClipAndSetupTriangle({ fctxs[corners[0]], fctxs[corners[1]], fctxs[corners[2]] },
+                           w, h, varyings, chunk);
+    }
+  });
+
+  AccumulateChunkStats();
+}
+
+template <typename Shader>
+void BasicRasterizer<Shader>::RasterizeTiles(DrawCall const *draws, FrameBuffer &frame_buffer)
+{
+  pool_->ParallelFor(tile_bins_.size(), [&](size_t tile) {
+    auto const &bin = tile_bins_[tile];
+    if (bin.empty()) return;
+
+    Vec2i clip_min, clip_max;
+    GetTileRegion(tile, frame_buffer, clip_min, clip_max);
+
+    if (depth_pre_pass_) {
+      for (auto const &entry : bin) {
+        DrawTriangle(*entry.triangle, draws[entry.draw_idx].shader, frame_buffer,
+                     clip_min, clip_max, RASTER_PASS_DEPTH);
+      }
+      for (auto const &entry : bin) {
+        DrawTriangle(*entry.triangle, draws[entry.draw_idx].shader, frame_buffer,
+                     clip_min, clip_max, RASTER_PASS_SHADE);
+      }
+    } else {
+      for (auto const &entry : bin) {
+        DrawTriangle(*entry.triangle, draws[entry.draw_idx].shader, frame_buffer,
+                     clip_min, clip_max);
+      }
+    }
+  });
+}
+
+extern template class BasicRasterizer<ShaderInterface>;
+
+using Rasterizer = BasicRasterizer<ShaderInterface>;
+using DrawCall = BasicDrawCall<ShaderInterface>;
+
 } // namespace kuro
 
 #endif
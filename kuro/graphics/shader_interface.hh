@@ -1,15 +1,18 @@
 #ifndef KURO_GRAPHICS_SHADER_INTERFACE_H__
 #define KURO_GRAPHICS_SHADER_INTERFACE_H__
 
+#include <stdint.h>
+#include <assert.h>
+#include <algorithm>
+
 #include "kuro/math/vec.hh"
 #include "kuro/math/matrix.hh"
+#include "kuro/img/frame_buffer.hh"
 
 #include "kuro/util/noncopyable.hh"
 
 namespace kuro {
 
-class FrameColor;
-
 /*
  * 通过读取模型文件获取顶点信息
  */
@@ -17,20 +20,156 @@ struct VertexContext {
   Vec3f pos;
   Vec3f normal;
   Vec2f uv;
+  Matrix4x4f const *model_matrix; // 所属draw call的模型矩阵
+  Matrix3x3f const *normal_matrix; // GetNormalMatrix(*model_matrix)
+};
+
+/*
+ * The vertexes processed in a batch.
+ * The attributes are in structure of arrays(the streams of VertexBuffer),
+ * such that they can be transformed in SIMD lanes.
+ */
+struct VertexBatch {
+  size_t num;
+  float const *xs;
+  float const *ys;
+  float const *zs;
+  float const *nxs;
+  float const *nys;
+  float const *nzs;
+  float const *us;
+  float const *vs;
+  Matrix4x4f const *model_matrix; // 所属draw call的模型矩阵
+  Matrix3x3f const *normal_matrix; // GetNormalMatrix(*model_matrix)
+  Matrix4x4f const *mvp_matrix; // projection * view * (*model_matrix)
+};
+
+/*
+ * The maximum number of floats of the varyings of a shader
+ */
+#define KURO_MAX_VARYING_NUM 16
+
+/*
+ * The varying is interpolated as VaryingType floats
+ */
+enum VaryingType : uint8_t {
+  VARYING_FLOAT = 1,
+  VARYING_VEC2,
+  VARYING_VEC3,
+  VARYING_VEC4,
+};
+
+/**
+ * \brief The varyings declared by the shader
+ *
+ * The varyings are packed in FragmentContext::varyings,
+ * only the declared floats are clipped and interpolated
+ * (perspective-correct) by the rasterizer,
+ * i.e. the shader pays for what it uses.
+ *
+ * The varying declared with interpolated = false is clipped and read by
+ * the triangle setup only(e.g. the world position of FlatShader for
+ * the face normal), it is not in FragmentPacket.
+ * They are packed after the interpolated ones, so they must be
+ * declared last.
+ */
+class VaryingLayout {
+ public:
+  /**
+   * \return The offset of the varying in FragmentContext::varyings
+   */
+  int Declare(VaryingType type, bool interpolated = true) noexcept
+  {
+    assert(num_ + type <= KURO_MAX_VARYING_NUM && "Too many varyings");
+    assert((!interpolated || num_ == interpolated_num_) &&
+           "The interpolated varyings must be declared first");
+    const int offset = num_;
+    num_ += type;
+    if (interpolated) interpolated_num_ = num_;
+    return offset;
+  }
+
+  /**
+   * \brief Declare the world space position of vertex(VARYING_VEC3)
+   *
+   * The triangle setup computes FragmentPacket::face_normal from it,
+   * the face normal is zero if it isn't declared.
+   */
+  int DeclareWorldPos(bool interpolated = true) noexcept
+  {
+    world_pos_ = Declare(VARYING_VEC3, interpolated);
+    return world_pos_;
+  }
+
+  /* The number of floats clipped */
+  int GetFloatNum() const noexcept { return num_; }
+
+  /* The number of floats interpolated, i.e. FragmentPacket::varying_num */
+  int GetInterpolatedNum() const noexcept { return interpolated_num_; }
+
+  /* -1 if the world position isn't declared */
+  int GetWorldPosOffset() const noexcept { return world_pos_; }
+
+ private:
+  int num_ = 0;
+  int interpolated_num_ = 0;
+  int world_pos_ = -1;
 };
 
 struct FragmentContext {
   Vec4f clip_pos;     // 剪切后的坐标
-  Vec3f world_pos;    // 世界空间中的坐标
-  Vec3f world_normal; // 世界空间的法向量
-  Vec2f uv; // 像素的uv坐标
   float intensity; // 光照强度
+
+  /* The varyings declared by ShaderInterface::varyings */
+  float varyings[KURO_MAX_VARYING_NUM];
+
+  template <size_t N>
+  Vec<float, N> GetVarying(int offset) const noexcept
+  {
+    Vec<float, N> ret;
+    for (size_t i = 0; i < N; ++i) ret[i] = varyings[offset + i];
+    return ret;
+  }
+
+  template <size_t N>
+  void SetVarying(int offset, Vec<float, N> const &v) noexcept
+  {
+    for (size_t i = 0; i < N; ++i) varyings[offset + i] = v[i];
+  }
+};
+
+/*
+ * The number of fragments shaded in a batch,
+ * same with the span of rasterizer
+ */
+#define KURO_FRAGMENT_PACKET_SIZE 8
+
+/*
+ * KURO_FRAGMENT_PACKET_SIZE horizontally adjacent fragments of
+ * a triangle in structure of arrays
+ */
+struct FragmentPacket {
+  int x; // The fragment of lane i is at (x + i, y)
+  int y;
+  uint32_t mask; // Bit i is set if lane i is covered and passes the depth test
+  alignas(32) float depth[KURO_FRAGMENT_PACKET_SIZE];
+
+  /* varyings[i][lane] is the float i of ShaderInterface::varyings */
+  int varying_num;
+  alignas(32) float varyings[KURO_MAX_VARYING_NUM][KURO_FRAGMENT_PACKET_SIZE];
+
+  /* The per-triangle constants */
+  Vec3f face_normal; // 世界空间中三角形的法向量(VaryingLayout::DeclareWorldPos())
 };
 
 class ShaderInterface : kanon::noncopyable {
  public:
   Vec3f uniform_light_dir;
+
+  /* Declared by the constructor of shader */
+  VaryingLayout varyings;
   
+  /* The model matrix of Rasterizer::Draw(Model const&...) */
   Matrix4x4f varying_model_matrix;
   Matrix4x4f varying_view_matrix;
   Matrix4x4f varying_projection_matrix;
@@ -40,6 +179,27 @@ class ShaderInterface : kanon::noncopyable {
   virtual ~ShaderInterface() = default;
   
   virtual FragmentContext VertexProcess(VertexContext &vctx) = 0;
+
+  /**
+   * \brief Process the vertexes of batch, fctxs[i] is the output of vertex i
+   *
+   * The default one calls VertexProcess() for every vertex,
+   * override it to transform the vertexes in SIMD.
+   */
+  virtual void VertexProcessBatch(VertexBatch const &batch,
+                                  FragmentContext *fctxs)
+  {
+    for (size_t i = 0; i < batch.num; ++i) {
+      VertexContext vctx{
+          .pos = Vec3f(batch.xs[i], batch.ys[i], batch.zs[i]),
+          .normal = Vec3f(batch.nxs[i], batch.nys[i], batch.nzs[i]),
+          .uv = Vec2f(batch.us[i], batch.vs[i]),
+          .model_matrix = batch.model_matrix,
+          .normal_matrix = batch.normal_matrix,
+      };
+      fctxs[i] = VertexProcess(vctx);
+    }
+  }
   
   /**
    * \return
@@ -48,6 +208,36 @@ class ShaderInterface : kanon::noncopyable {
    */
   virtual bool FragmentProcess(FragmentContext &fctx,
                                FrameColor &color) = 0;
+
+  /**
+   * \brief Shade the fragments of packet.mask
+   *
+   * The default one calls FragmentProcess() for every fragment,
+   * override it to shade the lanes in SIMD.
+   *
+   * \param colors The colors of lanes
+   * \return
+   *  The mask of chosen fragments(subset of packet.mask),
+   *  the others are discarded
+   */
+  virtual uint32_t FragmentProcessBatch(FragmentPacket const &packet,
+                                        FrameColor *colors)
+  {
+    const float intensity =
+        std::max(0.f, DotProduct(packet.face_normal, uniform_light_dir));
+
+    uint32_t chosen = 0;
+    for (uint32_t mask = packet.mask; mask != 0; mask &= mask - 1) {
+      const int lane = __builtin_ctz(mask);
+      FragmentContext fctx;
+      fctx.intensity = intensity;
+      for (int i = 0; i < packet.varying_num; ++i) {
+        fctx.varyings[i] = packet.varyings[i][lane];
+      }
+      if (FragmentProcess(fctx, colors[lane])) chosen |= 1u << lane;
+    }
+    return chosen;
+  }
 };
 
 } // namespace kuro
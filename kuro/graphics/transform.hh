@@ -13,7 +13,7 @@ namespace kuro {
  * Reason: 
  * Compared to multiple matrix to get the coordinate, multiple directly is better.
  */
-inline Matrix4x4f GetViewportMatrix(float w, float h) noexcept
+constexpr Matrix4x4f GetViewportMatrix(float w, float h) noexcept
 {
   return {
     { w/2, 0, 0, w/2 },
@@ -23,7 +23,7 @@ inline Matrix4x4f GetViewportMatrix(float w, float h) noexcept
   };
 }
 
-inline Vec3f GetViewPortCoordinate(Vec3f coor, float w, float h) noexcept
+constexpr Vec3f GetViewPortCoordinate(Vec3f coor, float w, float h) noexcept
 {
   return {
     (coor.x() + 1) * w / 2,
@@ -32,6 +32,26 @@ inline Vec3f GetViewPortCoordinate(Vec3f coor, float w, float h) noexcept
   };
 }
 
+constexpr Matrix4x4f GetTranslationMatrix(Vec3f t) noexcept
+{
+  return {
+    { 1, 0, 0, t.x() },
+    { 0, 1, 0, t.y() },
+    { 0, 0, 1, t.z() },
+    { 0, 0, 0, 1 }
+  };
+}
+
+constexpr Matrix4x4f GetScaleMatrix(Vec3f s) noexcept
+{
+  return {
+    { s.x(), 0, 0, 0 },
+    { 0, s.y(), 0, 0 },
+    { 0, 0, s.z(), 0 },
+    { 0, 0, 0, 1 }
+  };
+}
+
 /**
  * \param near The distance between near plane and camera
  * \param far The distance between far plane and camera
@@ -1,5 +1,6 @@
 #include "triangle.hh"
 
+#include "kuro/graphics/clipper.hh"
 #include "kuro/graphics/shader_interface.hh"
 #include "kuro/util/log.hh"
 
@@ -10,18 +11,29 @@
 
 namespace kuro {
 
-static std::tuple<Vec2f, Vec2f> GetBoundingBox(Vec2f const* vtxs, Vec2f clamp)
+/*
+ * The pixels whose center may be in the triangle
+ * Pixel x is in [floor((min - 0.5)), floor(max - 0.5)] in fixed point
+ */
+static std::tuple<Vec2i, Vec2i> GetBoundingBox(Vec2i const* vtxs, Vec2i clamp)
 {
-  Vec2f bbmin(vtxs[0].x(), vtxs[0].y());
-  Vec2f bbmax(vtxs[0].x(), vtxs[0].y());
+  Vec2i bbmin(vtxs[0].x(), vtxs[0].y());
+  Vec2i bbmax(vtxs[0].x(), vtxs[0].y());
 
   for (int i = 1; i < 3; ++i) {
     auto const &vertex = vtxs[i];
     for (int j = 0; j < 2; ++j) {
       bbmin[j] = std::min(bbmin[j], vertex[j]);
-      bbmax[j] = std::min(clamp[j], std::max(bbmax[j], vertex[j]));
+      bbmax[j] = std::max(bbmax[j], vertex[j]);
     }
   }
+
+  const int half = KURO_SUBPIXEL_ONE / 2;
+  for (int j = 0; j < 2; ++j) {
+    // Round up and round down(arithmetic shift)
+    bbmin[j] = std::max(0, (bbmin[j] - half + KURO_SUBPIXEL_ONE - 1) >> KURO_SUBPIXEL_BITS);
+    bbmax[j] = std::min(clamp[j], (bbmax[j] - half) >> KURO_SUBPIXEL_BITS);
+  }
 #if 0
   printf("Bounding box: \n");
   printf("(%d, %d)\n", bbmin[0], bbmin[1]);
@@ -30,20 +42,31 @@ static std::tuple<Vec2f, Vec2f> GetBoundingBox(Vec2f const* vtxs, Vec2f clamp)
   return {bbmin, bbmax};
 }
 
-static Vec3f GetBarycentric(Vec2f a, Vec2f b, Vec2f c, Vec2f p) noexcept
+static int64_t FloorDiv(int64_t a, int64_t b) noexcept
 {
-  auto pa = a - p;
-  auto ab = b - a;
-  auto ac = c - a;
+  assert(b > 0);
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
 
-  Vec3f u(ac.x(), ab.x(), pa.x());
-  Vec3f v(ac.y(), ab.y(), pa.y());
-  
-  auto t = CrossProduct3(v, u);
-  if (std::fabs(t.z()) <= 1e-2)
-    return { -1., 1., 1. };
-  else
-    return Vec3f(1. - (t.x()+t.y())/t.z(), t.y()/t.z(), t.x()/t.z());
+/*
+ * The top-left rule:
+ * The pixel center in the edge belongs to the triangle only if
+ * the edge is a left edge or top edge.
+ *
+ * (a, b) is the inward normal of the edge(inside positive).
+ * Left edge: the inside is at the right(a > 0)
+ * Top edge: horizontal and the inside is below it(a == 0, b < 0)
+ *
+ * NOTICE
+ * The frame buffer is flipped vertically when displayed,
+ * i.e. the y axis is upward.
+ *
+ * The two triangles sharing an edge have the opposite normals,
+ * hence exactly one of them owns the edge.
+ */
+static bool IsTopLeftEdge(int32_t a, int32_t b) noexcept
+{
+  return a > 0 || (a == 0 && b < 0);
 }
 
 void DrawTriangle(Vec2i a, Vec2i b, Vec2i c, FrameColor const &color,
@@ -77,78 +100,207 @@ float WorldToScreenCoor(int axis, float world_coor) noexcept
   return ((world_coor + 1.0) * axis / 2);
 }
 
-void DrawTriangle(std::array<FragmentContext, 3> const &fctxs,
-                  ShaderInterface *shader, FrameBuffer &buffer) noexcept
+/*
+ * f(p) = sum(E[i](p) / area * values[i])
+ * is the plane through the values of vertexes, relative to origin
+ */
+static PlaneEquation GetPlane(float const *values, int32_t const *edge_a,
+                              int32_t const *edge_b, int64_t const *origin_e,
+                              int64_t area) noexcept
 {
-  Vec3f bc_coor;
-  Vec2f bbmin, bbmax;
-  
-  Vec3f world_coors[3];
-  
+  double a = 0;
+  double b = 0;
+  double c = 0;
   for (int i = 0; i < 3; ++i) {
-    world_coors[i] = fctxs[i].world_pos;
+    const double weight = values[i] / (double)area;
+    a += (double)edge_a[i] * KURO_SUBPIXEL_ONE * weight;
+    b += (double)edge_b[i] * KURO_SUBPIXEL_ONE * weight;
+    c += (double)origin_e[i] * weight;
   }
 
+  PlaneEquation plane;
+  plane.a = (float)a;
+  plane.b = (float)b;
+  plane.c = (float)c;
+  return plane;
+}
+
+/*
+ * The area is positive if the triangle is counter-clockwise
+ */
+static bool IsCulledFace(int64_t area, CullState const &cull) noexcept
+{
+  if (cull.cull_mode == CULL_NONE) return false;
+
+  const bool is_front = (area > 0) == (cull.front_face == FRONT_FACE_CCW);
+  return is_front == (cull.cull_mode == CULL_FRONT);
+}
+
+bool SetupTriangle(std::array<FragmentContext, 3> const &fctxs, int w, int h,
+                   TriangleSetup &setup, CullState const &cull,
+                   CullStats *stats, VaryingLayout const *varyings) noexcept
+{
+  setup.bbmin = Vec2i(0, 0);
+  setup.bbmax = Vec2i(-1, -1);
+
   Vec3f ndc_coors[3];
   for (int i = 0; i < 3; ++i) {
-    DebugPrintf("World Coordinate = (%f, %f, %f)\n", world_coors[i][0], world_coors[i][1], world_coors[i][2]);
     DebugPrintf("Clip Coordinate = (%f, %f, %f, %f)\n", fctxs[i].clip_pos[0], fctxs[i].clip_pos[1], fctxs[i].clip_pos[2], fctxs[i].clip_pos[3]);
     ndc_coors[i] = ClipVec<3>(fctxs[i].clip_pos/fctxs[i].clip_pos[3]);
     
     DebugPrintf("NDC Coordinate = (%f, %f, %f, %f)\n", ndc_coors[i][0], ndc_coors[i][1], ndc_coors[i][2]);
-    if (std::fabs(ndc_coors[i][0]) > 1.0 || std::fabs(ndc_coors[i][1]) > 1.0)
-      return;
   }
   
-  Vec2f screen_coor[3];
-  float screen_depth[3];
+  auto const screen_coor = setup.screen_coor;
+  for (int i = 0; i < 3; ++i) {
+    // Snap to the sub-pixel grid
+    screen_coor[i][0] = (int)std::lround((ndc_coors[i].x() + 1.0) * w / 2 * KURO_SUBPIXEL_ONE);
+    screen_coor[i][1] = (int)std::lround((ndc_coors[i].y() + 1.0) * h / 2 * KURO_SUBPIXEL_ONE);
+    setup.screen_depth[i] = ndc_coors[i].z();
+  }
+  setup.max_depth = std::max(setup.screen_depth[0],
+                             std::max(setup.screen_depth[1], setup.screen_depth[2]));
+
+  std::tie(setup.bbmin, setup.bbmax) =
+      GetBoundingBox(screen_coor, Vec2i(w-1, h-1));
 
+  // No pixel center is covered
+  if (setup.bbmin.x() > setup.bbmax.x() || setup.bbmin.y() > setup.bbmax.y()) {
+    if (stats) stats->offscreen_num++;
+    return false;
+  }
+  
+  /*
+   * The edge function of edge(from, to):
+   * E(p) = (to - from) x (p - from)
+   *
+   * E(p) == 0 if p is in the edge,
+   * E(p) > 0 if p is in the left side of the edge.
+   */
+  int32_t edge_a[3];
+  int32_t edge_b[3];
   for (int i = 0; i < 3; ++i) {
-    screen_coor[i][0] = (ndc_coors[i].x() + 1.0) * buffer.GetWidth() / 2;
-    screen_coor[i][1] = (ndc_coors[i].y() + 1.0) * buffer.GetHeight() / 2;
-    screen_depth[i] = ndc_coors[i].z();
+    auto const &from = screen_coor[(i+1) % 3];
+    auto const &to = screen_coor[(i+2) % 3];
+    edge_a[i] = from.y() - to.y();
+    edge_b[i] = to.x() - from.x();
   }
+
+  // Twice of the signed area in fixed point
+  int64_t area = (int64_t)edge_a[0] * (screen_coor[0].x() - screen_coor[1].x()) +
+                 (int64_t)edge_b[0] * (screen_coor[0].y() - screen_coor[1].y());
   
-  Vec2f clamp(buffer.GetWidth()-1, buffer.GetHeight()-1);
-  std::tie(bbmin, bbmax) =
-      GetBoundingBox(screen_coor, clamp);
-
-  Vec2i p;
-  for (p[0] = bbmin.x(); p[0] <= bbmax.x(); p[0]++) {
-    for (p[1] = bbmin.y(); p[1] <= bbmax.y(); p[1]++) {
-      bc_coor = GetBarycentric(screen_coor[0], screen_coor[1], screen_coor[2],
-                               ToVecf(p));
-      if (bc_coor.x() < 0 || bc_coor.y() < 0 || bc_coor.z() < 0) {
-        continue;
-      }
+  // Degenerate triangle covers no pixel
+  if (area == 0) {
+    setup.bbmax = Vec2i(-1, -1);
+    if (stats) stats->degenerate_num++;
+    return false;
+  }
 
-      float interpolated_depth = 0.;
-      for (int i = 0; i < 3; ++i) {
-        interpolated_depth += bc_coor[i] * screen_depth[i];
-      }
+  if (IsCulledFace(area, cull)) {
+    setup.bbmax = Vec2i(-1, -1);
+    if (stats) stats->face_num++;
+    return false;
+  }
 
-      if (interpolated_depth <= buffer.GetDepth(p.x(), p.y())) 
-      {
-        continue;
-      }
+  // Make the inside positive whatever the winding is
+  if (area < 0) {
+    for (int i = 0; i < 3; ++i) {
+      edge_a[i] = -edge_a[i];
+      edge_b[i] = -edge_b[i];
+    }
+    area = -area;
+  }
+
+  setup.origin = setup.bbmin;
 
-      FrameColor color;
-      FragmentContext fctx;
+  // The center of origin pixel in fixed point
+  const int64_t ox = (int64_t)setup.origin.x() * KURO_SUBPIXEL_ONE + KURO_SUBPIXEL_ONE / 2;
+  const int64_t oy = (int64_t)setup.origin.y() * KURO_SUBPIXEL_ONE + KURO_SUBPIXEL_ONE / 2;
 
-      // 注意叉积方向
-      auto face_normal =
-          -CrossProduct3(world_coors[1] - world_coors[0], world_coors[2] - world_coors[0])
-              .Normalize();
+  int64_t origin_e[3];
+  for (int i = 0; i < 3; ++i) {
+    auto const &from = screen_coor[(i+1) % 3];
+    origin_e[i] = edge_a[i] * (ox - from.x()) + edge_b[i] * (oy - from.y());
 
-      fctx.intensity =
-          std::max(0.f, DotProduct(face_normal, shader->uniform_light_dir));
+    /*
+     * E(p + (1, 0)) = E(p) + a * KURO_SUBPIXEL_ONE,
+     * so E(p) / KURO_SUBPIXEL_ONE(round down) steps a per pixel,
+     * and its sign is same with E(p).
+     *
+     * The pixel center in the edge which isn't top-left is outside,
+     * i.e. E(p) >= 1 is required.
+     */
+    const int bias = IsTopLeftEdge(edge_a[i], edge_b[i]) ? 0 : 1;
 
-      if (shader->FragmentProcess(fctx, color)) {
-        buffer.UpdateDepth(p.x(), p.y(), interpolated_depth);
-        buffer.SetPixel(p.x(), p.y(), color);
-      }
+    auto &edge = setup.edges[i];
+    edge.a = edge_a[i];
+    edge.b = edge_b[i];
+    edge.c = FloorDiv(origin_e[i] - bias, KURO_SUBPIXEL_ONE);
+  }
+
+  setup.depth = GetPlane(setup.screen_depth, edge_a, edge_b, origin_e, area);
+
+  /*
+   * Only the varyings declared by shader.
+   * The varyings are linear in clip space instead of screen space,
+   * but varying/w and 1/w are linear in screen space.
+   */
+  const int varying_num = varyings ? varyings->GetInterpolatedNum() : 0;
+  setup.varying_num = varying_num;
+  if (varying_num > 0) {
+    float inv_ws[3];
+    for (int i = 0; i < 3; ++i) {
+      inv_ws[i] = 1.f / fctxs[i].clip_pos.w();
+    }
+    setup.inv_w = GetPlane(inv_ws, edge_a, edge_b, origin_e, area);
+
+    for (int i = 0; i < varying_num; ++i) {
+      const float values[3] = { fctxs[0].varyings[i] * inv_ws[0],
+                                fctxs[1].varyings[i] * inv_ws[1],
+                                fctxs[2].varyings[i] * inv_ws[2] };
+      setup.varyings[i] = GetPlane(values, edge_a, edge_b, origin_e, area);
     }
   }
+
+  const int world_pos = varyings ? varyings->GetWorldPosOffset() : -1;
+  if (world_pos >= 0) {
+    const auto w0 = fctxs[0].GetVarying<3>(world_pos);
+    const auto w1 = fctxs[1].GetVarying<3>(world_pos);
+    const auto w2 = fctxs[2].GetVarying<3>(world_pos);
+    // 注意叉积方向
+    setup.face_normal = -CrossProduct3(w1 - w0, w2 - w0).Normalize();
+  } else {
+    setup.face_normal = Vec3f();
+  }
+
+  if (stats) stats->setup_num++;
+  return true;
 }
 
+void DrawTriangle(std::array<FragmentContext, 3> const &fctxs,
+                  ShaderInterface *shader, FrameBuffer &buffer) noexcept
+{
+  const int varying_num = shader->varyings.GetFloatNum();
+
+  ClipPolygon polygon;
+  if (!ClipTriangle(fctxs, polygon, varying_num)) return;
+
+  TriangleSetup setup;
+  for (int i = 1; i + 1 < polygon.num; ++i) {
+    if (!SetupTriangle({ polygon.vertexes[0], polygon.vertexes[i], polygon.vertexes[i+1] },
+                       buffer.GetWidth(), buffer.GetHeight(), setup, CullState(),
+                       nullptr, &shader->varyings))
+      continue;
+
+    DrawTriangle(setup, shader, buffer, Vec2i(0, 0),
+                 Vec2i(buffer.GetWidth()-1, buffer.GetHeight()-1));
+  }
+}
+
+template void DrawTriangle<ShaderInterface>(TriangleSetup const &setup,
+                                            ShaderInterface *shader, FrameBuffer &buffer,
+                                            Vec2i clip_min, Vec2i clip_max,
+                                            RasterPass pass) noexcept;
+
 } // namespace kuro
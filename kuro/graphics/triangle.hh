@@ -1,19 +1,406 @@
 #ifndef KURO_GRAPHICS_TRIANGLE_H__
 #define KURO_GRAPHICS_TRIANGLE_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
 #include "kuro/img/frame_buffer.hh"
 #include "kuro/math/vec.hh"
+#include "kuro/math/util.hh"
+#include "kuro/graphics/raster_kernel.hh"
+#include "kuro/graphics/shader_interface.hh"
 
 namespace kuro {
 
-class ShaderInterface;
-class FragmentContext;
+/*
+ * The screen coordinates of vertexes are snapped to
+ * fixed point with KURO_SUBPIXEL_BITS fractional bits
+ */
+#define KURO_SUBPIXEL_BITS 8
+#define KURO_SUBPIXEL_ONE (1 << KURO_SUBPIXEL_BITS)
+
+/*
+ * The winding of front faces in screen space(the y axis is upward)
+ */
+enum FrontFace : uint8_t {
+  FRONT_FACE_CCW = 0,
+  FRONT_FACE_CW,
+};
+
+enum CullMode : uint8_t {
+  CULL_NONE = 0,
+  CULL_BACK,
+  CULL_FRONT,
+};
+
+struct CullState {
+  FrontFace front_face = FRONT_FACE_CCW;
+  CullMode cull_mode = CULL_NONE;
+};
+
+/*
+ * The number of triangles removed by each test
+ */
+struct CullStats {
+  size_t input_num = 0;      // Triangles from vertex processing
+  size_t frustum_num = 0;    // Out of the view frustum
+  size_t offscreen_num = 0;  // No pixel center in the bounding box
+  size_t degenerate_num = 0; // Zero area
+  size_t face_num = 0;       // Culled by the cull mode
+  size_t setup_num = 0;      // Passed to rasterization
+
+  CullStats &operator+=(CullStats const &rhs) noexcept
+  {
+    input_num += rhs.input_num;
+    frustum_num += rhs.frustum_num;
+    offscreen_num += rhs.offscreen_num;
+    degenerate_num += rhs.degenerate_num;
+    face_num += rhs.face_num;
+    setup_num += rhs.setup_num;
+    return *this;
+  }
+};
+
+/*
+ * The size of block classified by the edge functions at once,
+ * the width must be same with the span width.
+ */
+#define KURO_BLOCK_SIZE KURO_SPAN_WIDTH
+
+/*
+ * The limit of edge function values stepped in block.
+ * The screen coordinates must be less than 2^17 pixels such that
+ * the steps(|a|, |b|) in a block don't overflow it.
+ */
+#define KURO_EDGE_CLAMP (int64_t(1) << 30)
+
+/*
+ * The error bound of depth estimated at the block corners
+ * compared with the depth stepped by the span kernel.
+ * The Hi-Z test rejects the depth less than far depth - KURO_HIZ_EPSILON only.
+ */
+#define KURO_HIZ_EPSILON 1e-3f
+
+static_assert(KURO_FRAGMENT_PACKET_SIZE == KURO_SPAN_WIDTH,
+              "The span of block must be shaded in one packet");
+static_assert(KURO_BLOCK_SIZE == KURO_HIZ_BLOCK_SIZE,
+              "The block of rasterizer must be same with the Hi-Z block");
+
+/*
+ * COLOR: Depth test(greater), shade and write depth and color
+ * DEPTH: Depth test(greater) and write depth only, the shader is not called
+ * SHADE: Shade the pixels whose depth is equal to the buffered one,
+ *        i.e. the visible pixels after the DEPTH pass of all triangles
+ */
+enum RasterPass : uint8_t {
+  RASTER_PASS_COLOR = 0,
+  RASTER_PASS_DEPTH,
+  RASTER_PASS_SHADE,
+};
+
+/*
+ * f(x, y) = a*x + b*y + c
+ *
+ * The attributes which are linear in screen space(e.g. screen depth).
+ * Stepping one pixel in x(y) just adds a(b).
+ */
+struct PlaneEquation {
+  float a = 0;
+  float b = 0;
+  float c = 0;
+
+  float Evaluate(float x, float y) const noexcept { return a * x + b * y + c; }
+};
+
+/*
+ * E(x, y) = a*x + b*y + c
+ *
+ * The edge function in integer, (x, y) is the pixel,
+ * E(x, y) >= 0 iff the pixel center is in the triangle.
+ *
+ * E is the exact edge function of the snapped vertexes divided by
+ * KURO_SUBPIXEL_ONE(round down), and the top-left rule is folded into c,
+ * so the pixels in the shared edge are owned by one triangle only.
+ */
+struct EdgeFunction {
+  int32_t a = 0;
+  int32_t b = 0;
+  int64_t c = 0;
+
+  int64_t Evaluate(int x, int y) const noexcept
+  {
+    return (int64_t)a * x + (int64_t)b * y + c;
+  }
+};
+
+/*
+ * 经过顶点处理后的三角形在屏幕空间中的信息
+ * The result of SetupTriangle(), which can be rasterized
+ * in any screen region(e.g. tile) independently.
+ */
+struct TriangleSetup {
+  /* Snapped screen coordinates in fixed point */
+  Vec2i screen_coor[3];
+  float screen_depth[3];
+  /* The nearest depth, for Hi-Z test */
+  float max_depth;
+
+  /*
+   * edges[i] is the edge function of the edge opposite to vertex i.
+   * The winding is normalized such that edges[i] >= 0 inside.
+   *
+   * The edge functions and planes are relative to origin(a pixel near
+   * the triangle) instead of (0, 0), i.e. evaluated at p - origin,
+   * otherwise c is as large as the screen area and the round-off error
+   * of small triangles is not acceptable.
+   */
+  Vec2i origin;
+  EdgeFunction edges[3];
+  PlaneEquation depth;
+
+  /*
+   * The planes of 1/w and varying/w of the varyings declared by shader,
+   * which are linear in screen space instead of the varyings.
+   * They are not computed if varying_num == 0.
+   * \see VaryingLayout::GetInterpolatedNum()
+   */
+  int varying_num;
+  PlaneEquation inv_w;
+  PlaneEquation varyings[KURO_MAX_VARYING_NUM];
+
+  /* Pixel bounding box(inclusive), empty if bbmin > bbmax */
+  Vec2i bbmin;
+  Vec2i bbmax;
+
+  /* The constants passed to FragmentPacket */
+  Vec3f face_normal;
+};
 
 void DrawTriangle(Vec2i a, Vec2i b, Vec2i c, FrameColor const &color,
                   FrameBuffer &buffer) noexcept;
+
+/**
+ * \brief Clip, setup and rasterize the triangle in the whole frame buffer
+ */
 void DrawTriangle(std::array<FragmentContext, 3> const& fctxs,
                   ShaderInterface *shader, FrameBuffer &buffer) noexcept;
 
+/**
+ * \brief Project the triangle to screen space and cull it
+ *
+ * The triangle must be clipped by ClipTriangle() first.
+ * The triangle is culled if it covers no pixel center, has zero area,
+ * or faces the side culled by cull.cull_mode.
+ *
+ * \param w The width of the frame buffer
+ * \param h The height of the frame buffer
+ * \param stats The counter of the test culling the triangle is increased
+ *              if it is not NULL
+ * \param varyings The varyings declared by shader, the varyings aren't
+ *                 interpolated and the face normal is zero if it is NULL
+ *
+ * \return
+ *  false -- The triangle is culled(setup.bbmin > setup.bbmax also)
+ */
+bool SetupTriangle(std::array<FragmentContext, 3> const &fctxs, int w, int h,
+                   TriangleSetup &setup, CullState const &cull = CullState(),
+                   CullStats *stats = nullptr,
+                   VaryingLayout const *varyings = nullptr) noexcept;
+
+/**
+ * \brief Rasterize the part of triangle in the [clip_min, clip_max] region
+ *
+ * The pixels out of the region are not touched, so the different regions
+ * can be rasterized in different threads without locking.
+ *
+ * The shader is a template parameter, so the shader methods are inlined
+ * into the raster loop if the Shader is final(e.g. FlatShader).
+ * DrawTriangle<ShaderInterface>() is the type-erased one which calls
+ * the virtual methods.
+ *
+ * The fragments of a span are shaded in a batch by
+ * Shader::FragmentProcessBatch().
+ *
+ * \param pass The DEPTH and SHADE pass must be run with the same region,
+ *             otherwise the depth may not be bit-exact
+ */
+template <typename Shader>
+void DrawTriangle(TriangleSetup const &setup, Shader *shader,
+                  FrameBuffer &buffer, Vec2i clip_min, Vec2i clip_max,
+                  RasterPass pass = RASTER_PASS_COLOR) noexcept
+{
+  auto const &edges = setup.edges;
+
+  const int xmin = std::max(setup.bbmin.x(), clip_min.x());
+  const int ymin = std::max(setup.bbmin.y(), clip_min.y());
+  const int xmax = std::min(setup.bbmax.x(), clip_max.x());
+  const int ymax = std::min(setup.bbmax.y(), clip_max.y());
+
+  if (xmin > xmax || ymin > ymax) return;
+
+  /*
+   * Hi-Z:
+   * The triangle(block) is hidden if its nearest depth isn't greater than
+   * the far depth of every tile(block) it overlaps.
+   */
+  const float max_depth = setup.max_depth + KURO_HIZ_EPSILON;
+  bool is_hidden = true;
+  for (int ty = ymin / KURO_HIZ_TILE_SIZE; is_hidden && ty <= ymax / KURO_HIZ_TILE_SIZE; ++ty) {
+    for (int tx = xmin / KURO_HIZ_TILE_SIZE; tx <= xmax / KURO_HIZ_TILE_SIZE; ++tx) {
+      if (max_depth >= buffer.GetTileFarDepth(tx, ty)) {
+        is_hidden = false;
+        break;
+      }
+    }
+  }
+  if (is_hidden) return;
+
+  SpanOffsets offsets;
+  for (int lane = 0; lane < KURO_SPAN_WIDTH; ++lane) {
+    for (int i = 0; i < 3; ++i) {
+      offsets.edges[i][lane] = lane * edges[i].a;
+    }
+    offsets.depth[lane] = lane * setup.depth.a;
+  }
+
+  FragmentPacket packet;
+  packet.varying_num = setup.varying_num;
+  packet.face_normal = setup.face_normal;
+  FrameColor colors[KURO_FRAGMENT_PACKET_SIZE];
+
+  bool is_depth_written = false;
+  const DepthFunc depth_func = pass == RASTER_PASS_SHADE ? DEPTH_FUNC_EQUAL : DEPTH_FUNC_GREATER;
+
+  /*
+   * Walk the bounding box in blocks aligned to KURO_BLOCK_SIZE.
+   *
+   * Because the edge functions are linear, the minimum and maximum
+   * of them in a block are at the corners:
+   * - Any maximum < 0: the block is out of the triangle, skip it
+   * - All minimums >= 0: the block is in the triangle, only do depth test
+   * - Otherwise, test the coverage of every pixel
+   *
+   * One row of block is one span.
+   */
+  for (int by = ymin & ~(KURO_BLOCK_SIZE-1); by <= ymax; by += KURO_BLOCK_SIZE) {
+    const int y_begin = std::max(by, ymin);
+    const int y_end = std::min(by + KURO_BLOCK_SIZE - 1, ymax);
+
+    for (int bx = xmin & ~(KURO_BLOCK_SIZE-1); bx <= xmax; bx += KURO_BLOCK_SIZE) {
+      const int x_begin = std::max(bx, xmin);
+      const int x_end = std::min(bx + KURO_BLOCK_SIZE - 1, xmax);
+
+      const int rx = x_begin - setup.origin.x();
+      const int ry = y_begin - setup.origin.y();
+
+      int32_t e[3];
+      bool is_outside = false;
+      bool is_inside = true;
+      for (int i = 0; i < 3; ++i) {
+        const int64_t corner = edges[i].Evaluate(rx, ry);
+        const int64_t dx = (int64_t)edges[i].a * (x_end - x_begin);
+        const int64_t dy = (int64_t)edges[i].b * (y_end - y_begin);
+        const int64_t emin = corner + std::min<int64_t>(0, dx) + std::min<int64_t>(0, dy);
+        const int64_t emax = corner + std::max<int64_t>(0, dx) + std::max<int64_t>(0, dy);
+
+        if (emax < 0) is_outside = true;
+        if (emin < 0) is_inside = false;
+
+        /*
+         * Only the sign of pixel in the block is cared, and the values of
+         * pixels in the block differ from corner less than KURO_EDGE_CLAMP,
+         * hence the clamped value can be stepped in 32-bit integer.
+         */
+        e[i] = (int32_t)Clamp<int64_t>(corner, -KURO_EDGE_CLAMP, KURO_EDGE_CLAMP);
+      }
+
+      if (is_outside) continue;
+
+      const float block_max_depth = std::min(max_depth, KURO_HIZ_EPSILON + std::max(
+          std::max(setup.depth.Evaluate(rx, ry), setup.depth.Evaluate(rx + x_end - x_begin, ry)),
+          std::max(setup.depth.Evaluate(rx, ry + y_end - y_begin),
+                   setup.depth.Evaluate(rx + x_end - x_begin, ry + y_end - y_begin))));
+      if (block_max_depth < buffer.GetBlockFarDepth(bx / KURO_BLOCK_SIZE, by / KURO_BLOCK_SIZE))
+        continue;
+
+      float z = setup.depth.Evaluate(rx, ry);
+      const int lane_num = x_end - x_begin + 1;
+      bool is_written = false;
+
+      for (int y = y_begin; y <= y_end; ++y) {
+        float const *zbuffer = buffer.GetDepthRow(y) + x_begin;
+        uint32_t mask = is_inside ?
+          ComputeDepthMask(offsets, z, zbuffer, lane_num, packet.depth, depth_func) :
+          ComputeSpanMask(offsets, e, z, zbuffer, lane_num, packet.depth, depth_func);
+
+        if (mask != 0 && pass != RASTER_PASS_DEPTH) {
+          packet.x = x_begin;
+          packet.y = y;
+          packet.mask = mask;
+
+          if (setup.varying_num > 0) {
+            // Perspective correction: varying = (varying/w) / (1/w)
+            const float inv_w = setup.inv_w.Evaluate(rx, y - setup.origin.y());
+            alignas(32) float ws[KURO_FRAGMENT_PACKET_SIZE];
+            for (int lane = 0; lane < KURO_FRAGMENT_PACKET_SIZE; ++lane) {
+              ws[lane] = 1.f / (inv_w + lane * setup.inv_w.a);
+            }
+
+            for (int i = 0; i < setup.varying_num; ++i) {
+              auto const &plane = setup.varyings[i];
+              const float value = plane.Evaluate(rx, y - setup.origin.y());
+              for (int lane = 0; lane < KURO_FRAGMENT_PACKET_SIZE; ++lane) {
+                packet.varyings[i][lane] = (value + lane * plane.a) * ws[lane];
+              }
+            }
+          }
+
+          mask = shader->FragmentProcessBatch(packet, colors) & packet.mask;
+
+          for (uint32_t color_mask = mask; color_mask != 0; color_mask &= color_mask - 1) {
+            const int lane = __builtin_ctz(color_mask);
+            buffer.SetPixel(x_begin + lane, y, colors[lane]);
+          }
+        }
+
+        // The depth is same in the shading pass
+        if (pass != RASTER_PASS_SHADE) {
+          for (; mask != 0; mask &= mask - 1) {
+            const int lane = __builtin_ctz(mask);
+            buffer.UpdateDepth(x_begin + lane, y, packet.depth[lane]);
+            is_written = true;
+          }
+        }
+
+        for (int i = 0; i < 3; ++i) {
+          e[i] += edges[i].b;
+        }
+        z += setup.depth.b;
+      }
+
+      if (is_written) {
+        buffer.RefreshBlockFarDepth(bx / KURO_BLOCK_SIZE, by / KURO_BLOCK_SIZE);
+        is_depth_written = true;
+      }
+    }
+  }
+
+  if (is_depth_written) {
+    for (int ty = ymin / KURO_HIZ_TILE_SIZE; ty <= ymax / KURO_HIZ_TILE_SIZE; ++ty) {
+      for (int tx = xmin / KURO_HIZ_TILE_SIZE; tx <= xmax / KURO_HIZ_TILE_SIZE; ++tx) {
+        buffer.RefreshTileFarDepth(tx, ty);
+      }
+    }
+  }
+}
+
+extern template void DrawTriangle<ShaderInterface>(TriangleSetup const &setup,
+                                                   ShaderInterface *shader, FrameBuffer &buffer,
+                                                   Vec2i clip_min, Vec2i clip_max,
+                                                   RasterPass pass) noexcept;
+
 } // namespace kuro
 
 #endif
@@ -16,6 +16,7 @@
 #include "kuro/img/model.hh"
 #include "kuro/img/qimage_util.hh"
 #include "kuro/graphics/flat_shader.hh"
+#include "kuro/setting/option.hh"
 
 using namespace kuro;
 
@@ -30,8 +31,9 @@ static Vec2i QPointToVec(QPoint const &p)
 RendererView::RendererView()
   : scene_(new QGraphicsScene())
   , px_item_(new QGraphicsPixmapItem())
+  , rasterizer_(kuro_option().threads)
   , frame_buffer_(WIDTH, HEIGHT, FrameBuffer::IMAGE_TYPE_RGB)
-  , init_position_(0., 0., 1.)
+  , init_position_(0., 0., 2.1)
   , init_target_(0., 0., 0.)
   , camera_(init_target_, init_position_,
            frame_buffer_.GetWidth() / (float)frame_buffer_.GetHeight())
@@ -44,6 +46,14 @@ RendererView::RendererView()
   setScene(scene_);
   
   shader_ = new FlatShader();
+  rasterizer_.SetShader(shader_);
+
+  auto const &cull = kuro_option().cull;
+  if (cull == "none") {
+    rasterizer_.SetCullMode(CULL_NONE);
+  } else if (cull == "front") {
+    rasterizer_.SetCullMode(CULL_FRONT);
+  }
 
   connect(&timer_, &QTimer::timeout, this, [this]() {
     Render();
@@ -67,7 +77,7 @@ void RendererView::SetModel(Model &model)
 void RendererView::AddModel(char const *path)
 {
   Model model;
-  if (!model.ParseFrom(path)) {
+  if (!model.Load(path, kuro_option().cache_dir.c_str(), kuro_option().threads)) {
     // TODO Error handling
     return;
   }
@@ -167,53 +177,22 @@ void RendererView::Render()
   shader_->varying_projection_matrix = camera_.GetProjectionMatrix();
   shader_->varying_view_matrix = camera_.GetViewMatrix();
   // shader_->varying_model_matrix = renderer_.GetModel()->GetModelMatrix();
-  shader_->varying_model_matrix = GetIdentityF<4>();
+  static constexpr auto identity = GetIdentityF<4>();
+  shader_->varying_model_matrix = identity;
 
   shader_->uniform_light_dir = {0, 0, 1};
   
-  auto &frame_buffer = frame_buffer_;
-
-  frame_buffer.ClearAllPixel();
-  frame_buffer.ClearDepth();
-   
+  draws_.clear();
   for (auto const &name_model : models_) {
-    auto const model = &name_model.second;
-    for (size_t i = 0; i < model->GetFacesNum(); ++i) {
-      auto &face = model->GetFace(i);
-      std::array<FragmentContext, 3> fctxs;
-      const auto polygon_vertex_num = face.size();
-      if (polygon_vertex_num < 3 || polygon_vertex_num > 4) {
-        fprintf(stderr, "Can't process polygon whose vertexes num less than 3 or "
-                        "greater than 4");
-        return;
-      }
-
-      int tri_vtxes[3] = {0, 1, 2};
-
-      int tri_num = 1;
-      if (polygon_vertex_num == 4) tri_num++;
-      for (; tri_num > 0; --tri_num) {
-        for (int i = 0; i < 3; ++i) {
-          auto &mesh = face[tri_vtxes[i]];
-          VertexContext vctx{
-              .pos = model->GetVertex(mesh.vertex_idx),
-              .normal = model->GetNormal(mesh.normal_idx),
-              .uv = ClipVec<2>(model->GetTexture(mesh.uv_idx)),
-          };
-          fctxs[i] = shader_->VertexProcess(vctx);
-        }
-
-        DrawTriangle(fctxs, shader_, frame_buffer);
-
-        if (polygon_vertex_num == 4) {
-          tri_vtxes[0] = 2;
-          tri_vtxes[1] = 3;
-          tri_vtxes[2] = 0;
-        }
-      }
-    }
+    ViewRasterizer::DrawCall draw;
+    draw.model = &name_model.second;
+    draw.model_matrix = shader_->varying_model_matrix;
+    draw.shader = shader_;
+    draws_.push_back(draw);
   }
 
+  rasterizer_.Render(draws_, frame_buffer_);
+
   image = FrameBufferToQImage(frame_buffer_);
   px_item_->setPixmap(QPixmap::fromImage(image));
 
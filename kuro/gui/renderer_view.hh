@@ -13,11 +13,11 @@
 #include "kuro/img/frame_buffer.hh"
 #include "kuro/graphics/camera.hh"
 #include "kuro/graphics/rasterizer.hh"
+#include "kuro/graphics/flat_shader.hh"
 
 namespace kuro {
 
 class Model;
-class ShaderInterface;
 
 struct FrameContext {
   float avg_time = 0;
@@ -63,12 +63,19 @@ class RendererView : public QGraphicsView {
   QImage image;
   
   std::unordered_map<std::string, Model> models_;
+  /* The shader is known at compile time, so it is inlined into the rasterizer */
+  using ViewRasterizer = BasicRasterizer<FlatShader>;
+
+  /* The draw calls of models_ in current frame */
+  std::vector<ViewRasterizer::DrawCall> draws_;
   
-  ShaderInterface *shader_;
+  FlatShader *shader_;
+  ViewRasterizer rasterizer_;
   FrameBuffer frame_buffer_;
   float frame_count_ = 0;
   FrameContext frame_context_;
   
+  /* Far enough to see the whole normalized model(in [-1, 1]) */
   Vec3f init_position_;
   Vec3f init_target_;
   Camera camera_;
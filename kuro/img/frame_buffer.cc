@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <algorithm>
 
 using namespace kuro;
 
@@ -52,3 +53,41 @@ void FrameBuffer::ClearAllPixel() noexcept
     data_[i++] = 0xff;
   }
 }
+
+void FrameBuffer::RefreshBlockFarDepth(int bx, int by) noexcept
+{
+  const int x_begin = bx * KURO_HIZ_BLOCK_SIZE;
+  const int y_begin = by * KURO_HIZ_BLOCK_SIZE;
+  const int x_end = std::min(x_begin + KURO_HIZ_BLOCK_SIZE, width_);
+  const int y_end = std::min(y_begin + KURO_HIZ_BLOCK_SIZE, height_);
+  CheckCoordinate(x_begin, y_begin);
+
+  float far_depth = std::numeric_limits<float>::max();
+  for (int y = y_begin; y < y_end; ++y) {
+    float const *row = &zbuffer_[y * width_];
+    for (int x = x_begin; x < x_end; ++x) {
+      far_depth = std::min(far_depth, row[x]);
+    }
+  }
+
+  block_far_depth_[bx + by * block_cols_] = far_depth;
+}
+
+void FrameBuffer::RefreshTileFarDepth(int tx, int ty) noexcept
+{
+  const int block_num = KURO_HIZ_TILE_SIZE / KURO_HIZ_BLOCK_SIZE;
+  const int block_rows = (int)block_far_depth_.size() / block_cols_;
+  const int bx_begin = tx * block_num;
+  const int by_begin = ty * block_num;
+  const int bx_end = std::min(bx_begin + block_num, block_cols_);
+  const int by_end = std::min(by_begin + block_num, block_rows);
+
+  float far_depth = std::numeric_limits<float>::max();
+  for (int by = by_begin; by < by_end; ++by) {
+    for (int bx = bx_begin; bx < bx_end; ++bx) {
+      far_depth = std::min(far_depth, block_far_depth_[bx + by * block_cols_]);
+    }
+  }
+
+  tile_far_depth_[tx + ty * tile_cols_] = far_depth;
+}
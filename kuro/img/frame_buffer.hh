@@ -9,6 +9,14 @@
 
 namespace kuro {
 
+/*
+ * The size of block and tile of the hierarchical depth buffer(Hi-Z).
+ * They are same with the block classified by the rasterizer and
+ * the tile of Rasterizer, so the bounds are owned by one thread.
+ */
+#define KURO_HIZ_BLOCK_SIZE 8
+#define KURO_HIZ_TILE_SIZE 64
+
 struct FrameColor {
   static const FrameColor red;
   static const FrameColor green;
@@ -49,6 +57,12 @@ class FrameBuffer {
     , type_(t)
     , data_(w * h * GetBytesPerPixel(), 0) 
     , zbuffer_(w * h, -std::numeric_limits<float>::max())
+    , block_cols_((w + KURO_HIZ_BLOCK_SIZE - 1) / KURO_HIZ_BLOCK_SIZE)
+    , tile_cols_((w + KURO_HIZ_TILE_SIZE - 1) / KURO_HIZ_TILE_SIZE)
+    , block_far_depth_(block_cols_ * ((h + KURO_HIZ_BLOCK_SIZE - 1) / KURO_HIZ_BLOCK_SIZE),
+                       -std::numeric_limits<float>::max())
+    , tile_far_depth_(tile_cols_ * ((h + KURO_HIZ_TILE_SIZE - 1) / KURO_HIZ_TILE_SIZE),
+                      -std::numeric_limits<float>::max())
   {
   }
 
@@ -83,10 +97,26 @@ class FrameBuffer {
     return zbuffer_[x + y * width_]; 
   }
   
+  /*
+   * For the rasterizer to test a span of depths at once
+   */
+  float const *GetDepthRow(int y) const noexcept
+  {
+    CheckCoordinate(0, y);
+    return &zbuffer_[y * width_];
+  }
+
   void UpdateDepth(int x, int y, float d) noexcept
   {
     CheckCoordinate(x, y);
     zbuffer_[x + y * width_] = d;
+
+    // Keep the far depth conservative, it is tightened by
+    // RefreshBlockFarDepth() and RefreshTileFarDepth()
+    auto &block = block_far_depth_[x / KURO_HIZ_BLOCK_SIZE + y / KURO_HIZ_BLOCK_SIZE * block_cols_];
+    auto &tile = tile_far_depth_[x / KURO_HIZ_TILE_SIZE + y / KURO_HIZ_TILE_SIZE * tile_cols_];
+    if (d < block) block = d;
+    if (d < tile) tile = d;
   }
   
   void ClearDepth() noexcept
@@ -94,7 +124,40 @@ class FrameBuffer {
     for (auto &d : zbuffer_) {
       d = -std::numeric_limits<float>::max();
     }
+    for (auto &d : block_far_depth_) {
+      d = -std::numeric_limits<float>::max();
+    }
+    for (auto &d : tile_far_depth_) {
+      d = -std::numeric_limits<float>::max();
+    }
   }
+
+  /*
+   * Hi-Z:
+   * The far depth is a lower bound of the depths in the block(tile),
+   * so the fragment is hidden if its depth isn't greater than it.
+   */
+  float GetBlockFarDepth(int bx, int by) const noexcept
+  {
+    return block_far_depth_[bx + by * block_cols_];
+  }
+
+  float GetTileFarDepth(int tx, int ty) const noexcept
+  {
+    return tile_far_depth_[tx + ty * tile_cols_];
+  }
+
+  /**
+   * \brief Recompute the far depth of the block from the depth buffer
+   *
+   * The depth in the region can only be updated by the thread calling it.
+   */
+  void RefreshBlockFarDepth(int bx, int by) noexcept;
+
+  /**
+   * \brief Recompute the far depth of the tile from the far depth of blocks
+   */
+  void RefreshTileFarDepth(int tx, int ty) noexcept;
  private:
   void CheckCoordinate(int x, int y) const noexcept
   {
@@ -110,6 +173,11 @@ class FrameBuffer {
   ImageType type_;
   std::vector<uint8_t> data_;
   std::vector<float> zbuffer_;
+
+  int block_cols_;
+  int tile_cols_;
+  std::vector<float> block_far_depth_;
+  std::vector<float> tile_far_depth_;
 };
 
 } // namespace kuro
@@ -0,0 +1,274 @@
+#include "mesh_cache.hh"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "model.hh"
+#include "kuro/util/mapped_file.hh"
+
+using namespace kuro;
+
+static constexpr char MESH_CACHE_MAGIC[8] = { 'K', 'U', 'R', 'O', 'M', 'E', 'S', 'H' };
+static constexpr uint32_t MESH_CACHE_BYTE_ORDER = 0x01020304;
+
+static constexpr uint64_t AlignUp(uint64_t n) noexcept
+{
+  return (n + KURO_MESH_CACHE_ALIGN - 1) / KURO_MESH_CACHE_ALIGN * KURO_MESH_CACHE_ALIGN;
+}
+
+/* The sections are after the header */
+static constexpr uint64_t GetPayloadOffset() noexcept
+{
+  return AlignUp(sizeof(MeshCacheHeader));
+}
+
+/* The offsets of sections in the payload */
+struct MeshCacheLayout {
+  uint64_t vertexes;
+  uint64_t textures;
+  uint64_t normals;
+  uint64_t triangles;
+  uint64_t polygon_offsets;
+  uint64_t vertex_buffer;
+  uint64_t indexes;
+  uint64_t size;
+};
+
+static MeshCacheLayout GetLayout(MeshCacheHeader const &header) noexcept
+{
+  MeshCacheLayout layout;
+  uint64_t offset = 0;
+  auto section = [&offset](uint64_t size) {
+    const uint64_t ret = offset;
+    offset = AlignUp(offset + size);
+    return ret;
+  };
+
+  layout.vertexes = section(3 * sizeof(float) * header.vertex_num);
+  layout.textures = section(3 * sizeof(float) * header.texture_num);
+  layout.normals = section(3 * sizeof(float) * header.normal_num);
+  layout.triangles = section(9 * sizeof(int32_t) * header.triangle_num);
+  layout.polygon_offsets = section(sizeof(uint32_t) * (header.polygon_num + 1));
+  layout.vertex_buffer = section(VERTEX_STREAM_NUM * sizeof(float) * header.buffer_vertex_num);
+  layout.indexes = section(3 * sizeof(uint32_t) * header.triangle_num);
+  layout.size = offset;
+  return layout;
+}
+
+/* FNV-1a in 8 bytes words */
+static uint64_t HashPayload(char const *data, size_t size) noexcept
+{
+  uint64_t h = 14695981039346656037ull;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    ::memcpy(&word, data + i, sizeof word);
+    h = (h ^ word) * 1099511628211ull;
+  }
+  for (; i < size; ++i) {
+    h = (h ^ (unsigned char)data[i]) * 1099511628211ull;
+  }
+  return h;
+}
+
+static bool GetSourceStat(char const *path, uint64_t &size, int64_t &mtime) noexcept
+{
+  struct stat st;
+  if (::stat(path, &st) != 0) return false;
+  size = (uint64_t)st.st_size;
+  mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  return true;
+}
+
+/* The source is mapped, so it is hashed without copying */
+static bool HashSource(char const *path, uint64_t size, uint64_t &hash) noexcept
+{
+  MappedFile file;
+  if (!file.Open(path) || file.GetSize() != size) return false;
+  hash = HashPayload(file.GetData(), file.GetSize());
+  return true;
+}
+
+/* The attribute in structure of arrays */
+static void StoreVectors(std::vector<Vec3f> const &vecs, char *dst) noexcept
+{
+  const size_t num = vecs.size();
+  float *xs = reinterpret_cast<float *>(dst);
+  for (size_t i = 0; i < num; ++i) {
+    xs[i] = vecs[i].x();
+    xs[num + i] = vecs[i].y();
+    xs[2 * num + i] = vecs[i].z();
+  }
+}
+
+static void LoadVectors(char const *src, size_t num, std::vector<Vec3f> &vecs)
+{
+  // The sections are 16 bytes aligned in the page aligned mapping
+  float const *xs = reinterpret_cast<float const *>(src);
+  vecs.resize(num);
+  for (size_t i = 0; i < num; ++i) {
+    vecs[i] = Vec3f(xs[i], xs[num + i], xs[2 * num + i]);
+  }
+}
+
+namespace kuro {
+
+std::string GetMeshCachePath(char const *path, char const *cache_dir)
+{
+  if (!cache_dir || !*cache_dir) {
+    return std::string(path) + KURO_MESH_CACHE_SUFFIX;
+  }
+
+  // The files of same name in different directories have different caches
+  char real_path[PATH_MAX];
+  char const *full_path = ::realpath(path, real_path) ? real_path : path;
+  char hash[32];
+  ::snprintf(hash, sizeof hash, ".%016llx",
+             (unsigned long long)HashPayload(full_path, ::strlen(full_path)));
+
+  char const *basename = ::strrchr(path, '/');
+  basename = basename ? basename + 1 : path;
+
+  std::string ret(cache_dir);
+  if (ret.back() != '/') ret += '/';
+  ret += basename;
+  ret += hash;
+  ret += KURO_MESH_CACHE_SUFFIX;
+  return ret;
+}
+
+bool ReadMeshCache(char const *cache_path, char const *source_path, Model &model)
+{
+  uint64_t source_size;
+  int64_t source_mtime;
+  if (!GetSourceStat(source_path, source_size, source_mtime)) return false;
+
+  MappedFile file;
+  if (!file.Open(cache_path)) return false;
+  if (file.GetSize() < GetPayloadOffset()) return false;
+
+  MeshCacheHeader header;
+  ::memcpy(&header, file.GetData(), sizeof header);
+  if (::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof header.magic) != 0 ||
+      header.version != KURO_MESH_CACHE_VERSION ||
+      header.byte_order != MESH_CACHE_BYTE_ORDER) {
+    return false;
+  }
+
+  // Stale
+  if (header.source_size != source_size || header.source_mtime != source_mtime) {
+    return false;
+  }
+  uint64_t source_hash;
+  if (!HashSource(source_path, source_size, source_hash) ||
+      header.source_hash != source_hash) {
+    return false;
+  }
+
+  const auto layout = GetLayout(header);
+  if (header.payload_size != layout.size ||
+      file.GetSize() < GetPayloadOffset() + layout.size) {
+    return false;
+  }
+
+  char const *payload = file.GetData() + GetPayloadOffset();
+  if (HashPayload(payload, layout.size) != header.payload_hash) return false;
+
+  auto const *polygon_offsets = reinterpret_cast<uint32_t const *>(payload + layout.polygon_offsets);
+  if (polygon_offsets[0] != 0 || polygon_offsets[header.polygon_num] != header.triangle_num) {
+    return false;
+  }
+
+  LoadVectors(payload + layout.vertexes, header.vertex_num, model.vertexes());
+  LoadVectors(payload + layout.textures, header.texture_num, model.textures());
+  LoadVectors(payload + layout.normals, header.normal_num, model.normals());
+
+  // Model::Mesh is 3 ints, the triangles are copied directly
+  static_assert(sizeof(Model::Triangle) == 9 * sizeof(int32_t), "");
+  auto &triangles = model.triangles();
+  triangles.resize(header.triangle_num);
+  ::memcpy(triangles.data(), payload + layout.triangles, 9 * sizeof(int32_t) * header.triangle_num);
+
+  model.polygon_offsets().assign(polygon_offsets, polygon_offsets + header.polygon_num + 1);
+
+  // The vertex buffer is not built again
+  model.vertex_buffer().Assign(
+      reinterpret_cast<float const *>(payload + layout.vertex_buffer), header.buffer_vertex_num,
+      reinterpret_cast<uint32_t const *>(payload + layout.indexes), 3 * header.triangle_num);
+
+  model.SetBoundingCoordinate(
+      Vec3f(header.min_bounding_coor[0], header.min_bounding_coor[1], header.min_bounding_coor[2]),
+      Vec3f(header.max_bounding_coor[0], header.max_bounding_coor[1], header.max_bounding_coor[2]));
+  return true;
+}
+
+bool WriteMeshCache(char const *cache_path, char const *source_path, Model const &model)
+{
+  MeshCacheHeader header;
+  ::memset(&header, 0, sizeof header);
+  ::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof header.magic);
+  header.version = KURO_MESH_CACHE_VERSION;
+  header.byte_order = MESH_CACHE_BYTE_ORDER;
+  if (!GetSourceStat(source_path, header.source_size, header.source_mtime) ||
+      !HashSource(source_path, header.source_size, header.source_hash)) {
+    return false;
+  }
+
+  header.vertex_num = model.GetVertexesNum();
+  header.texture_num = model.GetTexturesNum();
+  header.normal_num = model.GetNormalsNum();
+  header.triangle_num = model.GetTrianglesNum();
+  header.polygon_num = model.GetPolygonsNum();
+  header.buffer_vertex_num = model.vertex_buffer().GetVertexesNum();
+  // The vertex buffer is out of date
+  if (model.vertex_buffer().GetIndexesNum() != 3 * header.triangle_num) return false;
+  for (int i = 0; i < 3; ++i) {
+    header.min_bounding_coor[i] = model.GetMinBoundingCoordinate()[i];
+    header.max_bounding_coor[i] = model.GetMaxBoundingCoordinate()[i];
+  }
+
+  const auto layout = GetLayout(header);
+  header.payload_size = layout.size;
+
+  // The padding is zero
+  std::vector<char> payload(layout.size, 0);
+  StoreVectors(model.vertexes(), payload.data() + layout.vertexes);
+  StoreVectors(model.textures(), payload.data() + layout.textures);
+  StoreVectors(model.normals(), payload.data() + layout.normals);
+
+  ::memcpy(payload.data() + layout.triangles, model.triangles().data(),
+           9 * sizeof(int32_t) * header.triangle_num);
+  ::memcpy(payload.data() + layout.polygon_offsets, model.polygon_offsets().data(),
+           sizeof(uint32_t) * (header.polygon_num + 1));
+
+  auto const &vertex_buffer = model.vertex_buffer();
+  ::memcpy(payload.data() + layout.vertex_buffer, vertex_buffer.GetStreams(),
+           VERTEX_STREAM_NUM * sizeof(float) * header.buffer_vertex_num);
+  ::memcpy(payload.data() + layout.indexes, vertex_buffer.indexes().data(),
+           sizeof(uint32_t) * vertex_buffer.GetIndexesNum());
+
+  header.payload_hash = HashPayload(payload.data(), payload.size());
+
+  char tmp_path[PATH_MAX];
+  ::snprintf(tmp_path, sizeof tmp_path, "%s.tmp%d", cache_path, (int)::getpid());
+  FILE *fp = ::fopen(tmp_path, "wb");
+  if (!fp) return false;
+
+  char header_buf[GetPayloadOffset()] = {};
+  ::memcpy(header_buf, &header, sizeof header);
+  const bool ok = ::fwrite(header_buf, 1, sizeof header_buf, fp) == sizeof header_buf &&
+                  ::fwrite(payload.data(), 1, payload.size(), fp) == payload.size();
+  if (::fclose(fp) != 0 || !ok || ::rename(tmp_path, cache_path) != 0) {
+    ::remove(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+} // namespace kuro
@@ -0,0 +1,92 @@
+#ifndef KURO_IMG_MESH_CACHE_H__
+#define KURO_IMG_MESH_CACHE_H__
+
+#include <stdint.h>
+#include <string>
+
+namespace kuro {
+
+class Model;
+
+/*
+ * The binary cache of the model parsed from *.obj file
+ *
+ * Layout:
+ * | MeshCacheHeader | sections... |
+ *
+ * The sections are aligned to KURO_MESH_CACHE_ALIGN bytes,
+ * every attribute is in structure of arrays(xs, ys, zs):
+ * - vertexes, textures, normals: float[3][num]
+ * - triangles: int32_t[triangle_num][3][3], the corners of
+ *   (vertex_idx, uv_idx, normal_idx)
+ * - polygon offsets: uint32_t[polygon_num+1]
+ * - vertex buffer: float[VERTEX_STREAM_NUM][buffer_vertex_num]
+ * - indexes of vertex buffer: uint32_t[triangle_num*3]
+ *   (the buffer is optimized, i.e. VertexBuffer::Optimize())
+ *
+ * The cache is in native byte order and is stale if
+ * the version, byte order or the size, mtime and hash of source
+ * are different, then the source is parsed again.
+ * The source is hashed only if its size and mtime are same,
+ * i.e. the edit keeping them(e.g. copied with the mtime) is detected also.
+ */
+#define KURO_MESH_CACHE_VERSION 5
+#define KURO_MESH_CACHE_ALIGN 16
+#define KURO_MESH_CACHE_SUFFIX ".kmc"
+
+struct MeshCacheHeader {
+  char magic[8]; // "KUROMESH"
+  uint32_t version;
+  uint32_t byte_order; // 0x01020304 in native order
+
+  /* The source file when the cache is written */
+  uint64_t source_size;
+  int64_t source_mtime; // in nanoseconds
+  uint64_t source_hash;
+
+  /* The hash of the sections, detect the corrupted cache */
+  uint64_t payload_hash;
+  uint64_t payload_size;
+
+  uint64_t vertex_num;
+  uint64_t texture_num;
+  uint64_t normal_num;
+  uint64_t triangle_num;
+  uint64_t polygon_num;
+  uint64_t buffer_vertex_num;
+
+  float min_bounding_coor[3];
+  float max_bounding_coor[3];
+};
+
+/**
+ * \brief The cache path of the source
+ * \param cache_dir
+ *  nullptr or empty -- Next to the source(path + KURO_MESH_CACHE_SUFFIX)
+ *  otherwise -- In the directory, the name is the basename of path
+ *               and the hash of path
+ */
+std::string GetMeshCachePath(char const *path, char const *cache_dir = nullptr);
+
+/**
+ * \brief Load the model from the cache of source_path
+ *
+ * The cache is mapped and the sections are copied to the model directly.
+ *
+ * \param model Must be empty
+ * \return
+ *  false -- The cache doesn't exist, is stale or corrupted
+ */
+bool ReadMeshCache(char const *cache_path, char const *source_path, Model &model);
+
+/**
+ * \brief Write the cache of the model parsed from source_path
+ *
+ * The cache is written to a temporary file then renamed,
+ * the readers never see a partial cache.
+ */
+bool WriteMeshCache(char const *cache_path, char const *source_path, Model const &model);
+
+} // namespace kuro
+
+#endif
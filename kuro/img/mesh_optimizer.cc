@@ -0,0 +1,141 @@
+#include "mesh_optimizer.hh"
+
+using namespace kuro;
+
+static constexpr uint32_t INVALID_VERTEX = UINT32_MAX;
+
+/*
+ * The FIFO cache is simulated by the timestamps:
+ * the time is increased by every miss, and the vertex is evicted
+ * after cache_size misses since it was put in the cache.
+ */
+static inline bool IsCached(uint32_t time, uint32_t cache_time, int cache_size) noexcept
+{
+  return time - cache_time <= (uint32_t)cache_size;
+}
+
+namespace kuro {
+
+float GetACMR(uint32_t const *indexes, size_t index_num, size_t vertex_num,
+              int cache_size)
+{
+  if (index_num < 3) return 0;
+
+  std::vector<uint32_t> cache_times(vertex_num, 0);
+  uint32_t time = cache_size + 1;
+  size_t miss_num = 0;
+  for (size_t i = 0; i < index_num; ++i) {
+    const uint32_t v = indexes[i];
+    if (!IsCached(time, cache_times[v], cache_size)) {
+      cache_times[v] = time++;
+      miss_num++;
+    }
+  }
+  return (float)miss_num / (index_num / 3);
+}
+
+void OptimizeVertexCache(uint32_t *out, uint32_t const *indexes, size_t index_num,
+                         size_t vertex_num, int cache_size)
+{
+  const size_t triangle_num = index_num / 3;
+
+  // The triangles of vertex v are adjacency[offsets[v], offsets[v+1])
+  std::vector<uint32_t> live_nums(vertex_num, 0);
+  for (size_t i = 0; i < 3 * triangle_num; ++i) {
+    live_nums[indexes[i]]++;
+  }
+
+  std::vector<uint32_t> offsets(vertex_num + 1, 0);
+  for (size_t v = 0; v < vertex_num; ++v) {
+    offsets[v + 1] = offsets[v] + live_nums[v];
+  }
+
+  std::vector<uint32_t> adjacency(3 * triangle_num);
+  {
+    std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < 3 * triangle_num; ++i) {
+      adjacency[cursors[indexes[i]]++] = (uint32_t)(i / 3);
+    }
+  }
+
+  std::vector<uint32_t> cache_times(vertex_num, 0);
+  std::vector<uint8_t> emitted(triangle_num, 0);
+  std::vector<uint32_t> dead_ends;
+  std::vector<uint32_t> candidates;
+  dead_ends.reserve(3 * triangle_num);
+
+  uint32_t time = cache_size + 1;
+  size_t cursor = 0;
+  size_t out_num = 0;
+
+  // The latest vertex having live triangles, or the next one in the input order
+  auto skip_dead_end = [&]() {
+    while (!dead_ends.empty()) {
+      const uint32_t v = dead_ends.back();
+      dead_ends.pop_back();
+      if (live_nums[v] > 0) return v;
+    }
+    for (; cursor < vertex_num; ++cursor) {
+      if (live_nums[cursor] > 0) return (uint32_t)cursor;
+    }
+    return INVALID_VERTEX;
+  };
+
+  uint32_t fanning = skip_dead_end();
+  while (fanning != INVALID_VERTEX) {
+    candidates.clear();
+
+    for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; ++k) {
+      const uint32_t t = adjacency[k];
+      if (emitted[t]) continue;
+      emitted[t] = 1;
+
+      for (int c = 0; c < 3; ++c) {
+        const uint32_t v = indexes[3 * t + c];
+        out[out_num++] = v;
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        live_nums[v]--;
+        if (!IsCached(time, cache_times[v], cache_size)) {
+          cache_times[v] = time++;
+        }
+      }
+    }
+
+    /*
+     * Prefer the candidate which is still in the cache after its live
+     * triangles are emitted(2 new vertexes per triangle at most),
+     * the older the better since it is evicted sooner
+     */
+    fanning = INVALID_VERTEX;
+    int64_t best_priority = -1;
+    for (const uint32_t v : candidates) {
+      if (live_nums[v] == 0) continue;
+
+      int64_t priority = 0;
+      const uint32_t age = time - cache_times[v];
+      if (age + 2 * live_nums[v] <= (uint32_t)cache_size) priority = age;
+      if (priority > best_priority) {
+        best_priority = priority;
+        fanning = v;
+      }
+    }
+    if (fanning == INVALID_VERTEX) fanning = skip_dead_end();
+  }
+}
+
+size_t OptimizeVertexFetch(uint32_t *indexes, size_t index_num, size_t vertex_num,
+                           std::vector<uint32_t> &remap)
+{
+  remap.assign(vertex_num, INVALID_VERTEX);
+
+  uint32_t next = 0;
+  for (size_t i = 0; i < index_num; ++i) {
+    uint32_t &v = remap[indexes[i]];
+    if (v == INVALID_VERTEX) v = next++;
+    indexes[i] = v;
+  }
+  return next;
+}
+
+} // namespace kuro
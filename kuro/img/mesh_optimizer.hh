@@ -0,0 +1,59 @@
+#ifndef KURO_IMG_MESH_OPTIMIZER_H__
+#define KURO_IMG_MESH_OPTIMIZER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace kuro {
+
+/*
+ * The number of vertexes of the post-transform cache(FIFO)
+ * which the triangles are reordered for and the ACMR is measured by
+ */
+#define KURO_VERTEX_CACHE_SIZE 32
+
+/**
+ * \brief The average cache miss ratio of the indexes
+ *
+ * i.e. The number of vertexes transformed per triangle with
+ * a FIFO cache of cache_size vertexes, 0.5 is about the best of
+ * the regular meshes and 3 is the worst.
+ */
+float GetACMR(uint32_t const *indexes, size_t index_num, size_t vertex_num,
+              int cache_size = KURO_VERTEX_CACHE_SIZE);
+
+/**
+ * \brief Reorder the triangles for the post-transform cache
+ *
+ * Tipsify: Fan the live triangles around a vertex, then continue from
+ * the oldest vertex of the fan which stays in the cache while its live
+ * triangles are emitted, i.e. age + 2 * live <= cache_size
+ * (the priority is the age, or 0 if it would be evicted).
+ * If no vertex of the fan has live triangles, continue from the latest
+ * vertex with live triangles(dead end), or the next one in the input order.
+ * It is linear in the number of indexes.
+ *
+ * \param out The reordered indexes, must not overlap indexes
+ * \see Sander et al., Fast Triangle Reordering for Vertex Locality
+ *      and Reduced Overdraw, SIGGRAPH 2007
+ */
+void OptimizeVertexCache(uint32_t *out, uint32_t const *indexes, size_t index_num,
+                         size_t vertex_num, int cache_size = KURO_VERTEX_CACHE_SIZE);
+
+/**
+ * \brief Renumber the vertexes in the order of first use
+ *
+ * The indexes are remapped in place, such that the vertexes are
+ * fetched almost sequentially.
+ *
+ * \param remap remap[old] is the new index of vertex old,
+ *              or UINT32_MAX if it is not referenced
+ * \return The number of the referenced vertexes
+ */
+size_t OptimizeVertexFetch(uint32_t *indexes, size_t index_num, size_t vertex_num,
+                           std::vector<uint32_t> &remap);
+
+} // namespace kuro
+
+#endif
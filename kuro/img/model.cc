@@ -1,14 +1,21 @@
 #include "model.hh"
 
+#include <atomic>
+#include <charconv>
 #include <exception>
+#include <memory>
+#include <string.h>
 
+#include "mesh_cache.hh"
 #include "kuro/math/vec.hh"
-#include "kuro/util/file.hh"
+#include "kuro/util/mapped_file.hh"
+#include "kuro/util/thread_pool.hh"
 #include "kuro/util/log.hh"
 
 using namespace kuro;
 
 Model::Model()
+  : polygon_offsets_(1, 0)
 {
   ResetBoundingCoordinate();
 }
@@ -24,50 +31,199 @@ Model::Model(char const *path)
 
 Model::~Model() noexcept = default;
 
-bool Model::ParseFrom(char const *path)
+/*
+ * The scanner of line [first, last)
+ * The tokens are parsed in place by std::from_chars(),
+ * which is locale-independent and doesn't require '\0'.
+ */
+static inline bool IsSpace(char c) noexcept
 {
-  File file;
-  if (!file.Open(path, File::READ)) return false;
-  std::string line;
+  return c == ' ' || c == '\t' || c == '\r';
+}
 
-  for (;;) {
-    auto ret = file.ReadLine(line, false);
-    if (ret == File::E_ERROR) return false;
-    if (ret == File::E_EOF) break;
+static inline char const *SkipSpaces(char const *first, char const *last) noexcept
+{
+  while (first != last && IsSpace(*first)) ++first;
+  return first;
+}
+
+static inline bool IsTokenEnd(char const *first, char const *last) noexcept
+{
+  return first == last || IsSpace(*first);
+}
+
+/* Skip the spaces before the number, first is after it if success */
+static inline bool ScanFloat(char const *&first, char const *last, float &value) noexcept
+{
+  first = SkipSpaces(first, last);
+  // from_chars() doesn't accept the plus sign
+  if (first != last && *first == '+') ++first;
+
+  auto ret = std::from_chars(first, last, value);
+  if (ret.ec != std::errc()) return false;
+  first = ret.ptr;
+  return IsTokenEnd(first, last);
+}
+
+static inline bool ScanInt(char const *&first, char const *last, int &value) noexcept
+{
+  if (first != last && *first == '+') ++first;
+
+  auto ret = std::from_chars(first, last, value);
+  if (ret.ec != std::errc()) return false;
+  first = ret.ptr;
+  return true;
+}
+
+/*
+ * The minimum size of chunk parsed by a thread,
+ * the smaller file is parsed in the caller thread
+ */
+#define KURO_OBJ_CHUNK_MIN_SIZE (256 * 1024)
+
+/* The mesh component of a relative index */
+struct IndexFixup {
+  uint32_t triangle; // The triangle index in the chunk
+  uint8_t corner;    // The corner of triangle(0-2) instead of polygon
+  uint8_t component; // 0: vertex, 1: uv, 2: normal
+};
+
+struct Model::ObjChunk {
+  char const *first;
+  char const *last;
+
+  Vectexes vertexes;
+  Textures textures;
+  Normals normals;
+  Triangles triangles;
+  /* The end of triangles of every polygon in the chunk */
+  PolygonOffsets polygon_ends;
+
+  /*
+   * The corners of the polygon being parsed and whether
+   * their components are relative(bit i of component i),
+   * reused to avoid allocation per polygon
+   */
+  std::vector<Mesh> polygon;
+  std::vector<uint8_t> polygon_relative;
+
+  Vec3f max_bounding_coor{ -std::numeric_limits<float>::max(),
+                           -std::numeric_limits<float>::max(),
+                           -std::numeric_limits<float>::max() };
+  Vec3f min_bounding_coor{ std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::max() };
+
+  /*
+   * The negative indexes are relative to the end of elements
+   * in the whole file. They're resolved in the chunk first,
+   * then rebased in the merge.
+   */
+  std::vector<IndexFixup> fixups;
+};
+
+static int Model::Mesh::*const MESH_COMPONENTS[3] = {
+  &Model::Mesh::vertex_idx,
+  &Model::Mesh::uv_idx,
+  &Model::Mesh::normal_idx,
+};
+
+bool Model::ParseFrom(char const *path, int thread_num)
+{
+  MappedFile file;
+  if (!file.Open(path)) return false;
+
+  char const *const data = file.GetData();
+  char const *const end = data + file.GetSize();
+
+  std::unique_ptr<ThreadPool> pool;
+  size_t chunk_num = 1;
+  if (thread_num != 1 && file.GetSize() >= 2 * KURO_OBJ_CHUNK_MIN_SIZE) {
+    pool.reset(new ThreadPool(thread_num));
+    // More chunks than threads to balance the load
+    chunk_num = std::min<size_t>(file.GetSize() / KURO_OBJ_CHUNK_MIN_SIZE,
+                                 (size_t)pool->GetThreadNum() * 4);
+  }
+
+  // Split at the line boundaries
+  std::vector<ObjChunk> chunks(chunk_num);
+  char const *first = data;
+  for (size_t i = 0; i < chunk_num; ++i) {
+    char const *last = end;
+    if (i + 1 < chunk_num) {
+      last = std::max(first, data + file.GetSize() * (i + 1) / chunk_num);
+      auto newline = static_cast<char const *>(::memchr(last, '\n', end - last));
+      last = newline ? newline + 1 : end;
+    }
+    chunks[i].first = first;
+    chunks[i].last = last;
+    first = last;
+  }
+
+  std::atomic<bool> ok{ true };
+  auto parse = [&](size_t i) {
+    if (!ParseChunk(chunks[i])) ok = false;
+  };
+  if (pool) {
+    pool->ParallelFor(chunk_num, parse);
+  } else {
+    parse(0);
+  }
+  if (!ok) return false;
+
+  MergeChunks(chunks, pool.get());
+  vertex_buffer_.Build(*this);
+
+  const auto stats = vertex_buffer_.Optimize();
+  DebugPrintf("%s: ACMR = %.3f -> %.3f\n", path, stats.acmr_before, stats.acmr_after);
+  return true;
+}
+
+bool Model::ParseChunk(ObjChunk &chunk)
+{
+  char const *cur = chunk.first;
+  char const *const end = chunk.last;
+
+  while (cur != end) {
+    auto newline = static_cast<char const *>(::memchr(cur, '\n', end - cur));
+    char const *line_end = newline ? newline : end;
+    char const *line = cur;
+    cur = newline ? newline + 1 : end;
 
     // Skip empty line
-    if (line.empty()) continue;
-    
-    // Because of SSO, the substr() might don't be a hot spot
+    if (line == line_end) continue;
+
     switch (line[0]) {
       case 'v':
       {
-        if (line[1] != ' ') {
+        if (line_end - line < 2) break;
+
+        if (!IsSpace(line[1])) {
           switch (line[1]) {
             case 't':
             {
-              if (!ParseTexture(line)) return false;
+              if (!ParseTexture(line + 2, line_end, chunk)) return false;
             } break;
 
             case 'n':
             {
-              if (!ParseNormal(line)) return false;
+              if (!ParseNormal(line + 2, line_end, chunk)) return false;
             } break;
 
             default:
               break;
           }
 
-        break;
+          break;
         }
 
-        ParseVertex(line);
+        if (!ParseVertex(line + 1, line_end, chunk)) return false;
 
       } break;
 
       case 'f':
       {
-        if (!ParseFace(line)) return false;
+        if (!ParseFace(line + 1, line_end, chunk)) return false;
       } break;
 
     }
@@ -76,181 +232,213 @@ bool Model::ParseFrom(char const *path)
   return true;
 }
 
-bool Model::ParseMesh(std::string const &mesh_slice, Face &face)
+void Model::MergeChunks(std::vector<ObjChunk> &chunks, ThreadPool *pool)
+{
+  const size_t chunk_num = chunks.size();
+
+  // The offsets of chunks in the elements are the prefix sums
+  std::vector<std::array<size_t, 5>> offsets(chunk_num);
+  std::array<size_t, 5> total{ vertexes_.size(), textures_.size(),
+                               normals_.size(), triangles_.size(),
+                               GetPolygonsNum() };
+  for (size_t i = 0; i < chunk_num; ++i) {
+    auto const &chunk = chunks[i];
+    offsets[i] = total;
+    total[0] += chunk.vertexes.size();
+    total[1] += chunk.textures.size();
+    total[2] += chunk.normals.size();
+    total[3] += chunk.triangles.size();
+    total[4] += chunk.polygon_ends.size();
+
+    for (int j = 0; j < 3; ++j) {
+      max_bounding_coor_[j] = std::max(max_bounding_coor_[j], chunk.max_bounding_coor[j]);
+      min_bounding_coor_[j] = std::min(min_bounding_coor_[j], chunk.min_bounding_coor[j]);
+    }
+  }
+
+  vertexes_.resize(total[0]);
+  textures_.resize(total[1]);
+  normals_.resize(total[2]);
+  triangles_.resize(total[3]);
+  polygon_offsets_.resize(total[4] + 1);
+
+  auto merge = [&](size_t i) {
+    auto &chunk = chunks[i];
+    auto const &offset = offsets[i];
+
+    for (auto const &fixup : chunk.fixups) {
+      auto &mesh = chunk.triangles[fixup.triangle][fixup.corner];
+      mesh.*MESH_COMPONENTS[fixup.component] += (int)offset[fixup.component];
+    }
+
+    std::copy(chunk.vertexes.begin(), chunk.vertexes.end(), vertexes_.begin() + offset[0]);
+    std::copy(chunk.textures.begin(), chunk.textures.end(), textures_.begin() + offset[1]);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), normals_.begin() + offset[2]);
+    std::copy(chunk.triangles.begin(), chunk.triangles.end(), triangles_.begin() + offset[3]);
+
+    auto polygon_offset = polygon_offsets_.begin() + offset[4] + 1;
+    for (auto end : chunk.polygon_ends) {
+      *polygon_offset++ = (uint32_t)offset[3] + end;
+    }
+  };
+
+  if (pool) {
+    pool->ParallelFor(chunk_num, merge);
+  } else {
+    for (size_t i = 0; i < chunk_num; ++i) merge(i);
+  }
+}
+
+bool Model::ParseMesh(char const *&first, char const *last, ObjChunk &chunk)
 {
-  std::array<int, 3> mesh{ -1, -1, -1 };
-  std::string::size_type slash_pos = std::string::npos;
-  std::string::size_type cur_pos = 0;
-  std::string numeric;
-  char *end = nullptr;
+  std::array<int, 3> mesh{ 0, 0, 0 };
+
+  // v, v/vt, v//vn, v/vt/vn
+  if (!ScanInt(first, last, mesh[0])) return false;
+  for (int i = 1; i < 3 && first != last && *first == '/'; ++i) {
+    ++first;
+    // The missing index
+    if (first != last && *first == '/') continue;
+    if (!ScanInt(first, last, mesh[i])) return false;
+  }
+  if (!IsTokenEnd(first, last)) return false;
 
+  const int sizes[3] = { (int)chunk.vertexes.size(), (int)chunk.textures.size(),
+                         (int)chunk.normals.size() };
+  uint8_t relative = 0;
   for (int i = 0; i < 3; ++i) {
-    slash_pos = mesh_slice.find('/', cur_pos);
-    
-    // std::string::npos is also OK
-    if (cur_pos != slash_pos) {
-      numeric = mesh_slice.substr(cur_pos, slash_pos-cur_pos);
-      mesh[i] = std::strtol(numeric.c_str(), &end, 10);
-      if (mesh[i] == 0 && end == numeric.c_str()) {
-        return false;
-      }
-      
-      // Avoid cur_pos round to 0(npos + 1 == 0)
-      if (slash_pos == std::string::npos) break;
-      cur_pos = slash_pos + 1;
+    if (mesh[i] > 0) {
+      mesh[i] -= 1;
+    } else if (mesh[i] < 0) {
+      // Relative to the end of the elements parsed, rebased in MergeChunks()
+      mesh[i] += sizes[i];
+      relative |= 1 << i;
     } else {
-      // No vertex index
-      if (i == 0)
-        return false; 
-      else
-        cur_pos++;
+      mesh[i] = -1;
     }
   }
-   
-  mesh[0] = mesh[0] > 0 ? (mesh[0] - 1) : (vertexes_.size() + mesh[0]);
-  mesh[1] = mesh[1] > 0 ? (mesh[1] - 1) : (textures_.size() + mesh[1]);
-  mesh[2] = mesh[2] > 0 ? (mesh[2] - 1) : (textures_.size() + mesh[2]);
-  face.push_back(Mesh{ mesh[0], mesh[1], mesh[2] });
+  chunk.polygon.push_back(Mesh{ mesh[0], mesh[1], mesh[2] });
+  chunk.polygon_relative.push_back(relative);
 
   return true;
 }
 
-bool Model::ParseTexture(std::string const &line)
+bool Model::ParseTexture(char const *first, char const *last, ObjChunk &chunk)
 {
   // u, [v, w]
   // v and w are optional(default: 0.)
-  Vec3f texture(NAN, 0., 0.);
-  
-  // Space count can greater than 1
-  std::string::size_type cur_pos = line.find_first_not_of(' ', 2);
-  if (cur_pos == std::string::npos) return false;
-  
-  std::string::size_type slash_pos = std::string::npos;
-  char *end = nullptr;
-  std::string numeric;
-
-  for (int i = 0; i < 3; ++i) {
-    slash_pos = line.find(' ', cur_pos);
-    
-    // std::string::npos is also OK
-    if (cur_pos != slash_pos) {
-      numeric = line.substr(cur_pos, slash_pos-cur_pos);
-      texture[i] = std::strtof(numeric.c_str(), &end);
-      if (texture[i] == 0 && end == numeric.c_str()) {
-        return false;
-      }
-
-      if (slash_pos == std::string::npos) break;
-      cur_pos = line.find_first_not_of(' ', slash_pos+1);
-    } else if (i == 0) {
-      // u is missing
-      return false; 
-    }
+  Vec3f texture(0., 0., 0.);
+
+  // u is required
+  if (!ScanFloat(first, last, texture[0])) return false;
+  for (int i = 1; i < 3; ++i) {
+    first = SkipSpaces(first, last);
+    if (first == last) break;
+    if (!ScanFloat(first, last, texture[i])) return false;
   }
 
-  textures_.push_back(std::move(texture));
+  chunk.textures.push_back(texture);
   return true;
 }
 
-bool Model::ParseNormal(std::string const &line)
+bool Model::ParseNormal(char const *first, char const *last, ObjChunk &chunk)
 {
   // (x, y, z)
   Vec3f normal(0, 0, 0);
-      
-  std::string::size_type cur_pos = line.find_first_not_of(' ', 2);
-  if (cur_pos == std::string::npos) return false;
-  
-  std::string::size_type slash_pos = std::string::npos;
-  char *end = nullptr;
-  std::string numeric;
 
   for (int i = 0; i < 3; ++i) {
-    slash_pos = line.find(' ', cur_pos);
-    
-    // std::string::npos is also OK
-    if (cur_pos != slash_pos) {
-      numeric = line.substr(cur_pos, slash_pos-cur_pos);
-      normal[i] = std::strtof(numeric.c_str(), &end);
-      if (normal[i] == 0 && end == numeric.c_str()) {
-        return false;
-      }
-      cur_pos = line.find_first_not_of(' ', slash_pos+1);
-    } else { 
-      return false; 
-    }
+    if (!ScanFloat(first, last, normal[i])) return false;
   }
 
-  normals_.push_back(std::move(normal));
+  chunk.normals.push_back(normal);
   return true;
 }
 
-bool Model::ParseVertex(std::string const &line)
+bool Model::ParseVertex(char const *first, char const *last, ObjChunk &chunk)
 {
-  size_t cur_pos = line.find_first_not_of(' ', 1);
-  if (cur_pos == std::string::npos) return false;
-
-  std::array<float, 3> vertex;
-  size_t slash_pos = std::string::npos;
-  char *end = nullptr;
-  std::string numeric;
-  
+  // (x, y, z, [w]), w is ignored
+  Vec3f vertex;
+
+  for (int i = 0; i < 3; ++i) {
+    if (!ScanFloat(first, last, vertex[i])) return false;
+  }
+
+  // The bounding box of chunk, reduced in MergeChunks()
   for (int i = 0; i < 3; ++i) {
-    slash_pos = line.find(' ', cur_pos);
-    if (slash_pos == std::string::npos && i != 2) {
+    chunk.max_bounding_coor[i] = std::max(chunk.max_bounding_coor[i], vertex[i]);
+    chunk.min_bounding_coor[i] = std::min(chunk.min_bounding_coor[i], vertex[i]);
+  }
+
+  chunk.vertexes.push_back(vertex);
+  return true;
+}
+
+bool Model::ParseFace(char const *first, char const *last, ObjChunk &chunk)
+{
+  auto &polygon = chunk.polygon;
+  auto &relative = chunk.polygon_relative;
+  polygon.clear();
+  relative.clear();
+
+  for (;;) {
+    first = SkipSpaces(first, last);
+    if (first == last) break;
+
+    if (!ParseMesh(first, last, chunk)) {
       return false;
     }
+  }
 
-    numeric = line.substr(cur_pos, slash_pos-cur_pos);
-    
-    vertex[i] = std::strtof(numeric.c_str(), &end);
-  
-    if (vertex[i] == 0.0 && end == numeric.c_str()) {
-      return false;
+  if (polygon.empty()) return false;
+
+  // Triangulate in fan, the points and lines have no triangle
+  for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+    const size_t corners[3] = { 0, i, i + 1 };
+    const auto triangle_idx = (uint32_t)chunk.triangles.size();
+
+    for (uint8_t corner = 0; corner < 3; ++corner) {
+      const uint8_t flags = relative[corners[corner]];
+      for (uint8_t component = 0; component < 3; ++component) {
+        if (flags & (1 << component)) {
+          chunk.fixups.push_back(IndexFixup{ triangle_idx, corner, component });
+        }
+      }
     }
 
-    cur_pos = line.find_first_not_of(' ', slash_pos+1);
-  }
-  
-  for (int i = 0; i < 3; ++i) {
-    max_bounding_coor_[i] = std::max(max_bounding_coor_[i], vertex[i]);
-    min_bounding_coor_[i] = std::min(min_bounding_coor_[i], vertex[i]);
+    chunk.triangles.push_back(
+        Triangle{ polygon[corners[0]], polygon[corners[1]], polygon[corners[2]] });
   }
 
-  vertexes_.emplace_back(vertex);
+  chunk.polygon_ends.push_back((uint32_t)chunk.triangles.size());
   return true;
 }
 
-bool Model::ParseFace(std::string const &line)
+bool Model::Load(char const *path, char const *cache_dir, int thread_num)
 {
-  size_t cur_pos = line.find_first_not_of(' ', 1);
-  if (cur_pos == std::string::npos) return false;
+  Clear();
 
-  std::string::size_type slash_pos = std::string::npos;
-  std::string mesh_slice;
-  std::string numeric;
-  Face face;
+  const auto cache_path = GetMeshCachePath(path, cache_dir);
+  if (ReadMeshCache(cache_path.c_str(), path, *this)) return true;
 
-  for (;;) {
-    slash_pos = line.find(' ', cur_pos);
-    mesh_slice = line.substr(cur_pos, slash_pos-cur_pos);
-     
-    if (!ParseMesh(mesh_slice, face)) {
-      return false;
-    }
-    
-    if (slash_pos == std::string::npos) break;
-    cur_pos = line.find_first_not_of(' ', slash_pos+1);
+  // The corrupted cache may be loaded partially
+  Clear();
+  if (!ParseFrom(path, thread_num)) return false;
+
+  if (!WriteMeshCache(cache_path.c_str(), path, *this)) {
+    DebugPrintf("Failed to write the mesh cache: %s\n", cache_path.c_str());
   }
-  faces_.push_back(std::move(face));
   return true;
 }
 
 void Model::Clear()
 {
   vertexes_.clear();
-  faces_.clear();
+  triangles_.clear();
+  polygon_offsets_.assign(1, 0);
   textures_.clear();
   normals_.clear();
+  vertex_buffer_.Clear();
+  ResetBoundingCoordinate();
 }
 
 Matrix4x4f Model::GetModelMatrix() const noexcept
@@ -297,4 +485,12 @@ void Model::ResetBoundingCoordinate() noexcept
 {
   max_bounding_coor_.Fill(-std::numeric_limits<float>::max());
   min_bounding_coor_.Fill(std::numeric_limits<float>::max());
+  has_model_matrix_cache_ = false;
+}
+
+void Model::SetBoundingCoordinate(Vec3f const &min, Vec3f const &max) noexcept
+{
+  min_bounding_coor_ = min;
+  max_bounding_coor_ = max;
+  has_model_matrix_cache_ = false;
 }
@@ -1,6 +1,8 @@
 #ifndef KURO_IMG_MODEL_H__
 #define KURO_IMG_MODEL_H__
 
+#include <array>
+#include <stdint.h>
 #include <vector>
 #include <string>
 #include <limits>
@@ -8,9 +10,23 @@
 #include "kuro/math/vec.hh"
 #include "kuro/math/matrix.hh"
 
+#include "vertex_buffer.hh"
+
 namespace kuro {
 
+class ThreadPool;
+
 /**
+ * The faces are triangulated when loaded and stored in
+ * a contiguous triangle array, the polygon of n vertexes is split to
+ * n-2 triangles in fan: (0, i, i+1).
+ * The triangles of polygon i are [offsets[i], offsets[i+1]) of
+ * polygon_offsets().
+ *
+ * The triangles are indexed into the vertex buffer(vertex_buffer())
+ * after loaded, which is the input of the rasterizer.
+ * Its triangles are reordered for the vertex locality.
+ *
  * \see https://en.wikipedia.org/wiki/Wavefront_.obj_file
  */
 class Model {
@@ -22,11 +38,12 @@ class Model {
   };
 
   using Vertex = Vec3f;
-  using Face = std::vector<Mesh>;
+  using Triangle = std::array<Mesh, 3>;
   using Texture = Vec3f;
   using Normal = Vec3f;
   using Vectexes = std::vector<Vec3f>;
-  using Faces = std::vector<std::vector<Mesh>>;
+  using Triangles = std::vector<Triangle>;
+  using PolygonOffsets = std::vector<uint32_t>;
   using Textures = std::vector<Vec3f>;
   using Normals = std::vector<Vec3f>;
 
@@ -34,23 +51,63 @@ class Model {
   explicit Model(char const *path);
   ~Model() noexcept;
   
-  bool ParseFrom(char const *path);
+  /**
+   * \brief Append the contents of *.obj file
+   *
+   * The file is mapped and scanned in place,
+   * no allocation is required for the tokens.
+   * The large file is split at the line boundaries and the chunks
+   * are parsed in parallel, then merged in the file order.
+   * The vertex buffer is rebuilt from all triangles and optimized
+   * for the post-transform cache, the ACMR is printed by DebugPrintf().
+   *
+   * \param thread_num The number of threads parsing the large file,
+   *                   <= 0 means the hardware concurrency
+   * \return
+   *  false -- The file can't be opened or is malformed,
+   *           the model is unchanged
+   */
+  bool ParseFrom(char const *path, int thread_num = 0);
+
+  /**
+   * \brief Load the model from the binary cache of *.obj file
+   *
+   * If the cache is missing or stale, the file is parsed by ParseFrom()
+   * and the cache is written for the next load.
+   * The model is cleared first.
+   *
+   * \param cache_dir The directory of cache, nullptr or empty means
+   *                  the cache is next to the file
+   * \param thread_num Passed to ParseFrom() if the file is parsed
+   * \see GetMeshCachePath()
+   */
+  bool Load(char const *path, char const *cache_dir = nullptr, int thread_num = 0);
+
   void Clear();
 
   Vectexes &vertexes() noexcept { return vertexes_; }
-  Faces &faces() noexcept { return faces_; }
+  Triangles &triangles() noexcept { return triangles_; }
+  PolygonOffsets &polygon_offsets() noexcept { return polygon_offsets_; }
   Textures &textures() noexcept { return textures_; }
   Normals &normals() noexcept { return normals_; }
+  Vectexes const &vertexes() const noexcept { return vertexes_; }
+  Triangles const &triangles() const noexcept { return triangles_; }
+  PolygonOffsets const &polygon_offsets() const noexcept { return polygon_offsets_; }
+  Textures const &textures() const noexcept { return textures_; }
+  Normals const &normals() const noexcept { return normals_; }
+  VertexBuffer &vertex_buffer() noexcept { return vertex_buffer_; }
+  VertexBuffer const &vertex_buffer() const noexcept { return vertex_buffer_; }
   
   size_t GetVertexesNum() const noexcept { return vertexes_.size(); }
-  size_t GetFacesNum() const noexcept { return faces_.size(); }
+  size_t GetTrianglesNum() const noexcept { return triangles_.size(); }
+  size_t GetPolygonsNum() const noexcept { return polygon_offsets_.size() - 1; }
   size_t GetTexturesNum() const noexcept { return textures_.size(); }
   size_t GetNormalsNum() const noexcept { return normals_.size(); }
 
   Vertex &GetVertex(size_t i) noexcept { return vertexes_[i]; }
   Vertex const &GetVertex(size_t i) const noexcept { return vertexes_[i]; }
-  Face &GetFace(size_t i) noexcept { return faces_[i]; }
-  Face const &GetFace(size_t i) const noexcept { return faces_[i]; }
+  Triangle &GetTriangle(size_t i) noexcept { return triangles_[i]; }
+  Triangle const &GetTriangle(size_t i) const noexcept { return triangles_[i]; }
   Texture &GetTexture(size_t i) noexcept { return textures_[i]; }
   Texture const &GetTexture(size_t i) const noexcept { return textures_[i]; }
   Normal &GetNormal(size_t i) noexcept { return normals_[i]; }
@@ -59,17 +116,42 @@ class Model {
   Matrix4x4f GetModelMatrix() const noexcept;
 
   void ResetBoundingCoordinate() noexcept;
+  void SetBoundingCoordinate(Vec3f const &min, Vec3f const &max) noexcept;
+  Vec3f const &GetMinBoundingCoordinate() const noexcept { return min_bounding_coor_; }
+  Vec3f const &GetMaxBoundingCoordinate() const noexcept { return max_bounding_coor_; }
  private:
-  bool ParseMesh(std::string const &mesh_slice, Face &face);
-  bool ParseTexture(std::string const &line);
-  bool ParseNormal(std::string const &line);
-  bool ParseVertex(std::string const &line);
-  bool ParseFace(std::string const &line);
+  /* The elements parsed from a range of lines of the file */
+  struct ObjChunk;
+
+  static bool ParseChunk(ObjChunk &chunk);
+
+  /*
+   * The line is [first, last) of the mapped file without newline,
+   * first is after the keyword(e.g. "v", "vt", "f")
+   */
+  static bool ParseMesh(char const *&first, char const *last, ObjChunk &chunk);
+  static bool ParseTexture(char const *first, char const *last, ObjChunk &chunk);
+  static bool ParseNormal(char const *first, char const *last, ObjChunk &chunk);
+  static bool ParseVertex(char const *first, char const *last, ObjChunk &chunk);
+  static bool ParseFace(char const *first, char const *last, ObjChunk &chunk);
+
+  /**
+   * \brief Append the elements of chunks in order
+   *
+   * The relative indexes of triangles are rebased by
+   * the elements of the previous chunks.
+   */
+  void MergeChunks(std::vector<ObjChunk> &chunks, ThreadPool *pool);
 
   Vectexes vertexes_;
-  Faces faces_;
+  Triangles triangles_;
+  /* polygon_offsets_[0] is 0 */
+  PolygonOffsets polygon_offsets_;
   Textures textures_;
   Normals normals_;
+
+  /* The distinct corners of triangles_ */
+  VertexBuffer vertex_buffer_;
   
   Vec3f max_bounding_coor_;
   Vec3f min_bounding_coor_;
@@ -0,0 +1,188 @@
+#include "vertex_buffer.hh"
+
+#include "mesh_optimizer.hh"
+#include "model.hh"
+
+using namespace kuro;
+
+static constexpr uint32_t EMPTY_SLOT = (uint32_t)-1;
+
+static inline uint64_t HashMesh(Model::Mesh const &mesh) noexcept
+{
+  uint64_t h = (uint32_t)mesh.vertex_idx * 0x9E3779B97F4A7C15ull;
+  h ^= (uint32_t)mesh.uv_idx * 0xC2B2AE3D27D4EB4Full;
+  h ^= (uint32_t)mesh.normal_idx * 0x165667B19E3779F9ull;
+  return h ^ (h >> 32);
+}
+
+static inline bool IsSameMesh(Model::Mesh const &x, Model::Mesh const &y) noexcept
+{
+  return x.vertex_idx == y.vertex_idx && x.uv_idx == y.uv_idx &&
+         x.normal_idx == y.normal_idx;
+}
+
+/*
+ * The hash set of the distinct meshes, the slot is the vertex index
+ * (i.e. the index of keys), linear probing.
+ * The capacity is power of 2 and the load factor is kept below 1/2.
+ */
+class MeshTable {
+ public:
+  explicit MeshTable(size_t expected_num)
+  {
+    size_t capacity = 16;
+    while (capacity < expected_num * 2) capacity <<= 1;
+    slots_.assign(capacity, EMPTY_SLOT);
+  }
+
+  /**
+   * \return The vertex index of mesh, the new one is keys.size()
+   *         and is appended to keys
+   */
+  uint32_t Insert(Model::Mesh const &mesh, std::vector<Model::Mesh> &keys)
+  {
+    if ((keys.size() + 1) * 2 > slots_.size()) Rehash(keys);
+
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = HashMesh(mesh) & mask;; i = (i + 1) & mask) {
+      const uint32_t slot = slots_[i];
+      if (slot == EMPTY_SLOT) {
+        slots_[i] = (uint32_t)keys.size();
+        keys.push_back(mesh);
+        return slots_[i];
+      }
+      if (IsSameMesh(keys[slot], mesh)) return slot;
+    }
+  }
+
+ private:
+  void Rehash(std::vector<Model::Mesh> const &keys)
+  {
+    slots_.assign(slots_.size() * 2, EMPTY_SLOT);
+    const size_t mask = slots_.size() - 1;
+    for (uint32_t k = 0; k < keys.size(); ++k) {
+      size_t i = HashMesh(keys[k]) & mask;
+      while (slots_[i] != EMPTY_SLOT) i = (i + 1) & mask;
+      slots_[i] = k;
+    }
+  }
+
+  std::vector<uint32_t> slots_;
+};
+
+/* The element of the index, or zero if the index is out of range(e.g. -1) */
+template <typename V>
+static inline V const &GetOrZero(std::vector<V> const &vecs, int idx) noexcept
+{
+  static const V zero{};
+  return (size_t)idx < vecs.size() ? vecs[idx] : zero;
+}
+
+void VertexBuffer::Build(Model const &model)
+{
+  Clear();
+
+  const size_t index_num = 3 * model.GetTrianglesNum();
+  indexes_.reserve(index_num);
+
+  // The distinct meshes are about as many as the positions usually
+  std::vector<Model::Mesh> keys;
+  MeshTable table(model.GetVertexesNum());
+
+  for (auto const &triangle : model.triangles()) {
+    for (auto const &mesh : triangle) {
+      indexes_.push_back(table.Insert(mesh, keys));
+    }
+  }
+
+  vertexes_.resize(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto const &mesh = keys[i];
+    auto &vertex = vertexes_[i];
+    vertex.pos = GetOrZero(model.vertexes(), mesh.vertex_idx);
+    vertex.normal = GetOrZero(model.normals(), mesh.normal_idx);
+    vertex.uv = ClipVec<2>(GetOrZero(model.textures(), mesh.uv_idx));
+  }
+
+  UpdateStreams();
+}
+
+VertexBufferStats VertexBuffer::Optimize()
+{
+  VertexBufferStats stats;
+  stats.acmr_before = GetACMR(indexes_.data(), indexes_.size(), vertexes_.size());
+
+  Indexes indexes(indexes_.size());
+  OptimizeVertexCache(indexes.data(), indexes_.data(), indexes_.size(), vertexes_.size());
+
+  std::vector<uint32_t> remap;
+  Vertexes vertexes(OptimizeVertexFetch(indexes.data(), indexes.size(),
+                                        vertexes_.size(), remap));
+  for (size_t i = 0; i < vertexes_.size(); ++i) {
+    if (remap[i] != UINT32_MAX) vertexes[remap[i]] = vertexes_[i];
+  }
+
+  indexes_.swap(indexes);
+  vertexes_.swap(vertexes);
+  UpdateStreams();
+
+  stats.acmr_after = GetACMR(indexes_.data(), indexes_.size(), vertexes_.size());
+  return stats;
+}
+
+void VertexBuffer::Assign(float const *streams, size_t vertex_num,
+                          uint32_t const *indexes, size_t index_num)
+{
+  vertexes_.resize(vertex_num);
+  streams_.assign(streams, streams + VERTEX_STREAM_NUM * vertex_num);
+  indexes_.assign(indexes, indexes + index_num);
+  UpdateVertexes();
+}
+
+void VertexBuffer::Clear() noexcept
+{
+  vertexes_.clear();
+  streams_.clear();
+  indexes_.clear();
+}
+
+void VertexBuffer::UpdateStreams()
+{
+  const size_t num = vertexes_.size();
+  streams_.resize(VERTEX_STREAM_NUM * num);
+
+  float *stream[VERTEX_STREAM_NUM];
+  for (int s = 0; s < VERTEX_STREAM_NUM; ++s) {
+    stream[s] = streams_.data() + s * num;
+  }
+
+  for (size_t i = 0; i < num; ++i) {
+    auto const &vertex = vertexes_[i];
+    stream[VERTEX_STREAM_X][i] = vertex.pos.x();
+    stream[VERTEX_STREAM_Y][i] = vertex.pos.y();
+    stream[VERTEX_STREAM_Z][i] = vertex.pos.z();
+    stream[VERTEX_STREAM_NX][i] = vertex.normal.x();
+    stream[VERTEX_STREAM_NY][i] = vertex.normal.y();
+    stream[VERTEX_STREAM_NZ][i] = vertex.normal.z();
+    stream[VERTEX_STREAM_U][i] = vertex.uv.x();
+    stream[VERTEX_STREAM_V][i] = vertex.uv.y();
+  }
+}
+
+void VertexBuffer::UpdateVertexes()
+{
+  const size_t num = vertexes_.size();
+  float const *stream[VERTEX_STREAM_NUM];
+  for (int s = 0; s < VERTEX_STREAM_NUM; ++s) {
+    stream[s] = streams_.data() + s * num;
+  }
+
+  for (size_t i = 0; i < num; ++i) {
+    auto &vertex = vertexes_[i];
+    vertex.pos = Vec3f(stream[VERTEX_STREAM_X][i], stream[VERTEX_STREAM_Y][i],
+                       stream[VERTEX_STREAM_Z][i]);
+    vertex.normal = Vec3f(stream[VERTEX_STREAM_NX][i], stream[VERTEX_STREAM_NY][i],
+                          stream[VERTEX_STREAM_NZ][i]);
+    vertex.uv = Vec2f(stream[VERTEX_STREAM_U][i], stream[VERTEX_STREAM_V][i]);
+  }
+}
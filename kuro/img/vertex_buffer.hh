@@ -0,0 +1,120 @@
+#ifndef KURO_IMG_VERTEX_BUFFER_H__
+#define KURO_IMG_VERTEX_BUFFER_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "kuro/math/vec.hh"
+
+namespace kuro {
+
+class Model;
+
+/*
+ * The components of vertex in the structure of arrays
+ */
+enum VertexStream : uint8_t {
+  VERTEX_STREAM_X = 0,
+  VERTEX_STREAM_Y,
+  VERTEX_STREAM_Z,
+  VERTEX_STREAM_NX,
+  VERTEX_STREAM_NY,
+  VERTEX_STREAM_NZ,
+  VERTEX_STREAM_U,
+  VERTEX_STREAM_V,
+  VERTEX_STREAM_NUM,
+};
+
+/*
+ * The average cache miss ratio of the vertex buffer
+ * before and after VertexBuffer::Optimize()
+ * \see GetACMR()
+ */
+struct VertexBufferStats {
+  float acmr_before = 0;
+  float acmr_after = 0;
+};
+
+/**
+ * \brief The vertexes of model referenced by one index per triangle corner
+ *
+ * The corners of OBJ file index the position, uv and normal separately,
+ * the distinct (v, vt, vn) of them are the vertexes of buffer,
+ * such that the vertex shared by the adjacent triangles is fetched
+ * and transformed once.
+ *
+ * The vertexes are stored in two layouts:
+ * - Interleaved(vertexes()): one vertex is fetched at once
+ * - Structure of arrays(GetStream()): one component of the vertexes
+ *   is contiguous, they are transformed in SIMD lanes
+ *
+ * The triangle i is indexes()[3i, 3i+3).
+ */
+class VertexBuffer {
+ public:
+  struct Vertex {
+    Vec3f pos;
+    Vec3f normal;
+    Vec2f uv;
+  };
+
+  using Vertexes = std::vector<Vertex>;
+  using Indexes = std::vector<uint32_t>;
+
+  VertexBuffer() = default;
+
+  /**
+   * \brief Deduplicate the corners of triangles of model
+   *
+   * The vertexes are in the order of the first corner referencing them.
+   * The missing(or out of range) uv and normal are zero.
+   */
+  void Build(Model const &model);
+
+  /**
+   * \brief Reorder the triangles for the post-transform cache,
+   *        then the vertexes in the order of first use
+   *
+   * The triangles are no longer in the order of the model.
+   *
+   * \see OptimizeVertexCache(), OptimizeVertexFetch()
+   */
+  VertexBufferStats Optimize();
+
+  /**
+   * \brief Set the buffer to the vertexes in structure of arrays
+   * \param streams float[VERTEX_STREAM_NUM][vertex_num]
+   */
+  void Assign(float const *streams, size_t vertex_num,
+              uint32_t const *indexes, size_t index_num);
+
+  void Clear() noexcept;
+
+  Vertexes const &vertexes() const noexcept { return vertexes_; }
+  Indexes const &indexes() const noexcept { return indexes_; }
+
+  /* The streams are contiguous, i.e. float[VERTEX_STREAM_NUM][vertex_num] */
+  float const *GetStreams() const noexcept { return streams_.data(); }
+  float const *GetStream(VertexStream stream) const noexcept
+  {
+    return streams_.data() + stream * vertexes_.size();
+  }
+
+  size_t GetVertexesNum() const noexcept { return vertexes_.size(); }
+  size_t GetIndexesNum() const noexcept { return indexes_.size(); }
+  size_t GetTrianglesNum() const noexcept { return indexes_.size() / 3; }
+
+  Vertex const &GetVertex(size_t i) const noexcept { return vertexes_[i]; }
+
+ private:
+  void UpdateStreams();
+  void UpdateVertexes();
+
+  Vertexes vertexes_;
+  std::vector<float> streams_;
+  Indexes indexes_;
+};
+
+} // namespace kuro
+
+#endif
@@ -22,7 +22,7 @@ using namespace kuro;
 int main(int argc, char **argv)
 {
   char usage[4096];
-  snprintf(usage, sizeof usage, "%s [-m|--model obj files...]", argv[0]);
+  snprintf(usage, sizeof usage, "%s [-m|--model obj files...] [-j|--threads num] [-c|--cull none|back|front] [-C|--cache-dir dir]", argv[0]);
 
   takina::AddUsage(usage);
   takina::AddDescription("Simple software renderer don't depend on OpenGL\n"
@@ -30,6 +30,9 @@ int main(int argc, char **argv)
   
   auto &opt = kuro_option();
   takina::AddOption({"m", "model", "Wavefront object files", "MODEL FILES"}, &opt.models);
+  takina::AddOption({"j", "threads", "The number of threads rendering and parsing models(default: hardware concurrency)", "NUM"}, &opt.threads);
+  takina::AddOption({"c", "cull", "The faces culled: none, back, front(default: back)", "MODE"}, &opt.cull);
+  takina::AddOption({"C", "cache-dir", "The directory of mesh caches(default: next to the models)", "DIR"}, &opt.cache_dir);
   
   std::string errmsg;
   if (!takina::Parse(argc, argv, &errmsg)) {
@@ -37,6 +40,11 @@ int main(int argc, char **argv)
     return 1;
   }
 
+  if (opt.cull != "none" && opt.cull != "back" && opt.cull != "front") {
+    fprintf(stderr, "Invalid cull mode: %s\nUsage: %s\n", opt.cull.c_str(), usage);
+    return 1;
+  }
+
   QApplication app(argc, argv);
   MainWindow mwin;
 
@@ -0,0 +1,156 @@
+#include "matrix.hh"
+
+using namespace kuro;
+
+namespace kuro {
+
+Matrix4x4f InverseScalar(Matrix4x4f const &m) noexcept
+{
+  /*
+   * The determinants of 2x2 sub-matrices of the first two rows(s)
+   * and the last two rows(c), i.e. Laplace expansion
+   */
+  const float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+  const float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+  const float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+  const float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+  const float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+  const float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+  const float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+  const float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+  const float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+  const float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+  const float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+  const float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+  const float inv_det = 1.f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+  return {
+    {
+      ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * inv_det,
+      (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * inv_det,
+      ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * inv_det,
+      (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * inv_det,
+    },
+    {
+      (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * inv_det,
+      ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * inv_det,
+      (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * inv_det,
+      ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * inv_det,
+    },
+    {
+      ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * inv_det,
+      (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * inv_det,
+      ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * inv_det,
+      (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * inv_det,
+    },
+    {
+      (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * inv_det,
+      ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * inv_det,
+      (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * inv_det,
+      ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * inv_det,
+    },
+  };
+}
+
+#ifdef KURO_MATH_SSE
+
+/*
+ * The 2x2 matrix | m0 m1 | is stored in a register (m0, m1, m2, m3).
+ *                | m2 m3 |
+ * A# is the adjugate of A, i.e. | a3 -a1 |
+ *                               | -a2 a0 |
+ */
+#define SHUFFLE_MASK(x, y, z, w) ((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, SHUFFLE_MASK(x, y, z, w))
+
+/* A * B */
+static inline __m128 Mat2Mul(__m128 a, __m128 b) noexcept
+{
+  return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)),
+                    _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+/* A# * B */
+static inline __m128 Mat2AdjMul(__m128 a, __m128 b) noexcept
+{
+  return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b),
+                    _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+/* A * B# */
+static inline __m128 Mat2MulAdj(__m128 a, __m128 b) noexcept
+{
+  return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)),
+                    _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+/*
+ * M = | A B |, M^-1 = 1/|M| * | X Y |
+ *     | C D |                 | Z W |
+ *
+ * X# = |D|A - B(D#C)
+ * Y# = |B|C - D(A#B)#
+ * Z# = |C|B - A(D#C)#
+ * W# = |A|D - C(A#B)
+ * |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+ *
+ * \see https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+ */
+Matrix4x4f InverseSSE(Matrix4x4f const &m) noexcept
+{
+  const __m128 r0 = LoadRow(m, 0);
+  const __m128 r1 = LoadRow(m, 1);
+  const __m128 r2 = LoadRow(m, 2);
+  const __m128 r3 = LoadRow(m, 3);
+
+  const __m128 a = _mm_movelh_ps(r0, r1);
+  const __m128 b = _mm_movehl_ps(r1, r0);
+  const __m128 c = _mm_movelh_ps(r2, r3);
+  const __m128 d = _mm_movehl_ps(r3, r2);
+
+  // (|A|, |B|, |C|, |D|)
+  const __m128 det_sub = _mm_sub_ps(
+      _mm_mul_ps(_mm_shuffle_ps(r0, r2, SHUFFLE_MASK(0, 2, 0, 2)),
+                 _mm_shuffle_ps(r1, r3, SHUFFLE_MASK(1, 3, 1, 3))),
+      _mm_mul_ps(_mm_shuffle_ps(r0, r2, SHUFFLE_MASK(1, 3, 1, 3)),
+                 _mm_shuffle_ps(r1, r3, SHUFFLE_MASK(0, 2, 0, 2))));
+  const __m128 det_a = SWIZZLE(det_sub, 0, 0, 0, 0);
+  const __m128 det_b = SWIZZLE(det_sub, 1, 1, 1, 1);
+  const __m128 det_c = SWIZZLE(det_sub, 2, 2, 2, 2);
+  const __m128 det_d = SWIZZLE(det_sub, 3, 3, 3, 3);
+
+  const __m128 d_c = Mat2AdjMul(d, c);
+  const __m128 a_b = Mat2AdjMul(a, b);
+
+  __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), Mat2Mul(b, d_c));
+  __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), Mat2Mul(c, a_b));
+  __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), Mat2MulAdj(d, a_b));
+  __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), Mat2MulAdj(a, d_c));
+
+  __m128 tr = _mm_mul_ps(a_b, SWIZZLE(d_c, 0, 2, 1, 3));
+  tr = _mm_hadd_ps(tr, tr);
+  tr = _mm_hadd_ps(tr, tr);
+  const __m128 det_m = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d),
+                                             _mm_mul_ps(det_b, det_c)), tr);
+
+  // The signs of adjugate
+  const __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det_m);
+  x = _mm_mul_ps(x, inv_det);
+  y = _mm_mul_ps(y, inv_det);
+  z = _mm_mul_ps(z, inv_det);
+  w = _mm_mul_ps(w, inv_det);
+
+  // Adjugate the blocks and merge them to rows
+  Matrix4x4f ret;
+  StoreRow(ret, 0, _mm_shuffle_ps(x, y, SHUFFLE_MASK(3, 1, 3, 1)));
+  StoreRow(ret, 1, _mm_shuffle_ps(x, y, SHUFFLE_MASK(2, 0, 2, 0)));
+  StoreRow(ret, 2, _mm_shuffle_ps(z, w, SHUFFLE_MASK(3, 1, 3, 1)));
+  StoreRow(ret, 3, _mm_shuffle_ps(z, w, SHUFFLE_MASK(2, 0, 2, 0)));
+  return ret;
+}
+
+#endif // KURO_MATH_SSE
+
+} // namespace kuro
@@ -19,13 +19,13 @@ class Matrix {
   using Data = std::array<Row, R>;
 
  public:
-  Matrix() noexcept = default;
-  Matrix(Data const &data)
+  constexpr Matrix() noexcept = default;
+  constexpr Matrix(Data const &data)
     : data_(data)
   {
   }
 
-  Matrix(std::initializer_list<std::initializer_list<T>> data)
+  constexpr Matrix(std::initializer_list<std::initializer_list<T>> data)
   {
     SetData(data);
   }
@@ -33,9 +33,11 @@ class Matrix {
   template <typename = typename std::enable_if<
     !std::is_same<typename std::decay<T>::type, Matrix>::value
     >::type>
-  explicit Matrix(T const &init) noexcept { 
+  constexpr explicit Matrix(T const &init) noexcept { 
+    // std::array::fill() isn't constexpr until C++20
     for (auto &row : data_)
-      row.fill(init); 
+      for (auto &e : row)
+        e = init;
   }
   
   Matrix(Matrix const &) = default;
@@ -45,15 +47,15 @@ class Matrix {
 
   ~Matrix() noexcept = default;
 
-  Row &operator[](size_t r) noexcept { return data_[r]; }
-  Row const &operator[](size_t r) const noexcept { return data_[r]; }
+  constexpr Row &operator[](size_t r) noexcept { return data_[r]; }
+  constexpr Row const &operator[](size_t r) const noexcept { return data_[r]; }
 
   Vec<T, R> const &ToVec() const noexcept { return data_[0]; }
 
   Vec<T, R> &ToVec() noexcept { return data_[0]; }
 
-  size_t row() const noexcept { return R; }
-  size_t col() const noexcept { return C; }
+  constexpr size_t row() const noexcept { return R; }
+  constexpr size_t col() const noexcept { return C; }
   
   void Print() const noexcept
   {
@@ -64,7 +66,7 @@ class Matrix {
     }
   }
 
-  void SetData(std::initializer_list<std::initializer_list<T>> data)
+  constexpr void SetData(std::initializer_list<std::initializer_list<T>> data)
   {
     for (size_t i = 0; i < R; ++i) {
       for (size_t j = 0; j < C; ++j)
@@ -72,12 +74,13 @@ class Matrix {
     }
   }
  private:
-  Data data_;
+  /* The rows of Matrix4x4f can be loaded to SSE registers */
+  alignas(sizeof(Row) % 16 == 0 ? 16 : alignof(Data)) Data data_{};
 };
 
 template <typename T, size_t M, size_t K, size_t N>
-Matrix<T, M, N> MatrixMultiple(Matrix<T, M, K> const &a,
-                               Matrix<T, K, N> const &b) noexcept
+constexpr Matrix<T, M, N> MatrixMultiple(Matrix<T, M, K> const &a,
+                                         Matrix<T, K, N> const &b) noexcept
 {
   Matrix<T, M, N> c(0);
   for (size_t m = 0; m < M; ++m) {
@@ -91,14 +94,14 @@ Matrix<T, M, N> MatrixMultiple(Matrix<T, M, K> const &a,
 }
 
 template <typename T, size_t M, size_t K, size_t N>
-inline Matrix<T, M, N> operator*(Matrix<T, M, K> const &a,
-                                 Matrix<T, K, N> const &b) noexcept
+constexpr Matrix<T, M, N> operator*(Matrix<T, M, K> const &a,
+                                    Matrix<T, K, N> const &b) noexcept
 {
   return MatrixMultiple(a, b);
 }
 
 template <typename T, size_t M, size_t N>
-Vec<T, M> MatrixMultiple(Matrix<T, M, N> const &a, Vec<T, N> const &b) noexcept
+constexpr Vec<T, M> MatrixMultiple(Matrix<T, M, N> const &a, Vec<T, N> const &b) noexcept
 {
   Vec<T, M> ret;
   for (size_t i = 0; i < M; ++i) {
@@ -111,15 +114,15 @@ Vec<T, M> MatrixMultiple(Matrix<T, M, N> const &a, Vec<T, N> const &b) noexcept
 }
 
 template <typename T, size_t M, size_t N>
-inline Vec<T, M> operator*(Matrix<T, M, N> const &a, Vec<T, N> const &b) noexcept
+constexpr Vec<T, M> operator*(Matrix<T, M, N> const &a, Vec<T, N> const &b) noexcept
 {
   return MatrixMultiple(a, b);
 }
 
 template <size_t N, typename T>
-inline Matrix<T, N, N> GetIdentity() noexcept
+constexpr Matrix<T, N, N> GetIdentity() noexcept
 {
-  Matrix<T, N, N> ret;
+  Matrix<T, N, N> ret(0);
   for (size_t i = 0; i < N; ++i) {
     ret[i][i] = 1;
   }
@@ -127,17 +130,217 @@ inline Matrix<T, N, N> GetIdentity() noexcept
 }
 
 template <size_t N>
-inline Matrix<float, N, N> GetIdentityF() noexcept
+constexpr Matrix<float, N, N> GetIdentityF() noexcept
 {
   return GetIdentity<N, float>();
 }
 
+template <typename T, size_t R, size_t C>
+constexpr Matrix<T, C, R> Transpose(Matrix<T, R, C> const &m) noexcept
+{
+  Matrix<T, C, R> ret;
+  for (size_t i = 0; i < R; ++i) {
+    for (size_t j = 0; j < C; ++j) {
+      ret[j][i] = m[i][j];
+    }
+  }
+  return ret;
+}
+
 template <typename T>
 using Matrix4x4 = Matrix<T, 4, 4>;
 
 using Matrix4x4i = Matrix4x4<int>;
 using Matrix4x4f = Matrix4x4<float>;
 
+template <typename T>
+using Matrix3x3 = Matrix<T, 3, 3>;
+
+using Matrix3x3f = Matrix3x3<float>;
+
+/**
+ * \brief The inverse of m by the adjugate
+ *
+ * m must be invertible, otherwise the elements are inf or nan.
+ */
+constexpr Matrix3x3f Inverse(Matrix3x3f const &m) noexcept
+{
+  // The cofactors of the first row
+  const float c0 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+  const float c1 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+  const float c2 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+
+  const float inv_det = 1.f / (m[0][0] * c0 + m[0][1] * c1 + m[0][2] * c2);
+
+  return {
+    {
+      c0 * inv_det,
+      (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det,
+      (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det,
+    },
+    {
+      c1 * inv_det,
+      (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det,
+      (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det,
+    },
+    {
+      c2 * inv_det,
+      (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det,
+      (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det,
+    },
+  };
+}
+
+/* The linear part of the affine transform */
+constexpr Matrix3x3f GetUpperLeft3x3(Matrix4x4f const &m) noexcept
+{
+  return {
+    { m[0][0], m[0][1], m[0][2] },
+    { m[1][0], m[1][1], m[1][2] },
+    { m[2][0], m[2][1], m[2][2] },
+  };
+}
+
+/**
+ * \brief The inverse of the affine transform m = | A t |
+ *                                               | 0 1 |
+ *
+ * i.e. | A^-1 -A^-1*t |, cheaper than the general Inverse().
+ *      | 0     1      |
+ */
+constexpr Matrix4x4f AffineInverse(Matrix4x4f const &m) noexcept
+{
+  const Matrix3x3f inv = Inverse(GetUpperLeft3x3(m));
+  const Vec3f t = -(inv * Vec3f(m[0][3], m[1][3], m[2][3]));
+
+  return {
+    { inv[0][0], inv[0][1], inv[0][2], t[0] },
+    { inv[1][0], inv[1][1], inv[1][2], t[1] },
+    { inv[2][0], inv[2][1], inv[2][2], t[2] },
+    { 0, 0, 0, 1 },
+  };
+}
+
+/**
+ * \brief The matrix transforming the normals by the model matrix
+ *
+ * The normals are transformed by (A^-1)^T instead of A
+ * such that they're still orthogonal to the tangents
+ * if A has non-uniform scale.
+ * Compute it once per model matrix rather than per vertex.
+ */
+constexpr Matrix3x3f GetNormalMatrix(Matrix4x4f const &model) noexcept
+{
+  return Transpose(Inverse(GetUpperLeft3x3(model)));
+}
+
+/**
+ * \brief The inverse of m by the cofactors
+ *
+ * m must be invertible, otherwise the elements are inf or nan.
+ */
+Matrix4x4f InverseScalar(Matrix4x4f const &m) noexcept;
+
+#ifdef KURO_MATH_SSE
+
+inline __m128 LoadRow(Matrix4x4f const &m, size_t r) noexcept
+{
+  return _mm_load_ps(m[r].data());
+}
+
+inline void StoreRow(Matrix4x4f &m, size_t r, __m128 row) noexcept
+{
+  _mm_store_ps(m[r].data(), row);
+}
+
+/*
+ * The overloads of Matrix4x4f are prefered to the templates
+ */
+constexpr Matrix4x4f MatrixMultiple(Matrix4x4f const &a, Matrix4x4f const &b) noexcept
+{
+  if (KURO_IS_CONSTANT_EVALUATED()) return MatrixMultiple<float, 4, 4, 4>(a, b);
+
+  const __m128 b0 = LoadRow(b, 0);
+  const __m128 b1 = LoadRow(b, 1);
+  const __m128 b2 = LoadRow(b, 2);
+  const __m128 b3 = LoadRow(b, 3);
+
+  // Row i of c is the combination of rows of b weighted by row i of a
+  Matrix4x4f c;
+  for (size_t i = 0; i < 4; ++i) {
+    __m128 row = _mm_mul_ps(_mm_set1_ps(a[i][0]), b0);
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i][1]), b1));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i][2]), b2));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i][3]), b3));
+    StoreRow(c, i, row);
+  }
+  return c;
+}
+
+constexpr Matrix4x4f operator*(Matrix4x4f const &a, Matrix4x4f const &b) noexcept
+{
+  return MatrixMultiple(a, b);
+}
+
+constexpr Vec4f MatrixMultiple(Matrix4x4f const &a, Vec4f const &b) noexcept
+{
+  if (KURO_IS_CONSTANT_EVALUATED()) return MatrixMultiple<float, 4, 4>(a, b);
+
+  // The columns of a weighted by the elements of b
+  __m128 c0 = LoadRow(a, 0);
+  __m128 c1 = LoadRow(a, 1);
+  __m128 c2 = LoadRow(a, 2);
+  __m128 c3 = LoadRow(a, 3);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+  const __m128 v = LoadVec(b);
+  __m128 ret = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+  ret = _mm_add_ps(ret, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+  ret = _mm_add_ps(ret, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+  ret = _mm_add_ps(ret, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+  return StoreVec<Vec4f>(ret);
+}
+
+constexpr Vec4f operator*(Matrix4x4f const &a, Vec4f const &b) noexcept
+{
+  return MatrixMultiple(a, b);
+}
+
+constexpr Matrix4x4f Transpose(Matrix4x4f const &m) noexcept
+{
+  if (KURO_IS_CONSTANT_EVALUATED()) return Transpose<float, 4, 4>(m);
+
+  __m128 r0 = LoadRow(m, 0);
+  __m128 r1 = LoadRow(m, 1);
+  __m128 r2 = LoadRow(m, 2);
+  __m128 r3 = LoadRow(m, 3);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+  Matrix4x4f ret;
+  StoreRow(ret, 0, r0);
+  StoreRow(ret, 1, r1);
+  StoreRow(ret, 2, r2);
+  StoreRow(ret, 3, r3);
+  return ret;
+}
+
+/**
+ * \brief The inverse of m by the 2x2 blocks
+ * \see InverseScalar()
+ */
+Matrix4x4f InverseSSE(Matrix4x4f const &m) noexcept;
+
+#endif // KURO_MATH_SSE
+
+inline Matrix4x4f Inverse(Matrix4x4f const &m) noexcept
+{
+#ifdef KURO_MATH_SSE
+  return InverseSSE(m);
+#else
+  return InverseScalar(m);
+#endif
+}
+
 } // namespace kuro
 
 #endif
@@ -0,0 +1,137 @@
+#include "transform_kernel.hh"
+
+#include <assert.h>
+
+using namespace kuro;
+
+namespace kuro {
+
+void TransformPointsScalar(Matrix4x4f const &m, float const *xs,
+                           float const *ys, float const *zs, size_t n,
+                           float *const *out, int row_num) noexcept
+{
+  assert(row_num >= 1 && row_num <= 4);
+
+  for (int r = 0; r < row_num; ++r) {
+    // The locals can't be aliased by out, the loop is vectorizable
+    const float m0 = m[r][0], m1 = m[r][1], m2 = m[r][2], m3 = m[r][3];
+    float *dst = out[r];
+    for (size_t i = 0; i < n; ++i) {
+      dst[i] = m0 * xs[i] + m1 * ys[i] + m2 * zs[i] + m3;
+    }
+  }
+}
+
+void TransformVectorsScalar(Matrix3x3f const &m, float const *xs,
+                            float const *ys, float const *zs, size_t n,
+                            float *const *out) noexcept
+{
+  for (int r = 0; r < 3; ++r) {
+    const float m0 = m[r][0], m1 = m[r][1], m2 = m[r][2];
+    float *dst = out[r];
+    for (size_t i = 0; i < n; ++i) {
+      dst[i] = m0 * xs[i] + m1 * ys[i] + m2 * zs[i];
+    }
+  }
+}
+
+#ifdef KURO_MATH_AVX2
+
+/* The lanes [0, lane_num) are set */
+static inline __m256i GetValidLanes(size_t lane_num) noexcept
+{
+  const __m256i lane_idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32((int)lane_num), lane_idx);
+}
+
+/*
+ * The rows of matrix are broadcast once,
+ * every block of 8 points costs 3 FMA per output component.
+ * The tail block is loaded and stored with mask, so the
+ * results of a point don't depend on its position in the array.
+ */
+void TransformPointsAVX2(Matrix4x4f const &m, float const *xs,
+                         float const *ys, float const *zs, size_t n,
+                         float *const *out, int row_num) noexcept
+{
+  assert(row_num >= 1 && row_num <= 4);
+
+  __m256 rows[4][4];
+  for (int r = 0; r < row_num; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      rows[r][c] = _mm256_set1_ps(m[r][c]);
+    }
+  }
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 x = _mm256_loadu_ps(xs + i);
+    const __m256 y = _mm256_loadu_ps(ys + i);
+    const __m256 z = _mm256_loadu_ps(zs + i);
+
+    for (int r = 0; r < row_num; ++r) {
+      __m256 ret = _mm256_fmadd_ps(rows[r][2], z, rows[r][3]);
+      ret = _mm256_fmadd_ps(rows[r][1], y, ret);
+      ret = _mm256_fmadd_ps(rows[r][0], x, ret);
+      _mm256_storeu_ps(out[r] + i, ret);
+    }
+  }
+
+  if (i < n) {
+    const __m256i valid = GetValidLanes(n - i);
+    const __m256 x = _mm256_maskload_ps(xs + i, valid);
+    const __m256 y = _mm256_maskload_ps(ys + i, valid);
+    const __m256 z = _mm256_maskload_ps(zs + i, valid);
+
+    for (int r = 0; r < row_num; ++r) {
+      __m256 ret = _mm256_fmadd_ps(rows[r][2], z, rows[r][3]);
+      ret = _mm256_fmadd_ps(rows[r][1], y, ret);
+      ret = _mm256_fmadd_ps(rows[r][0], x, ret);
+      _mm256_maskstore_ps(out[r] + i, valid, ret);
+    }
+  }
+}
+
+void TransformVectorsAVX2(Matrix3x3f const &m, float const *xs,
+                          float const *ys, float const *zs, size_t n,
+                          float *const *out) noexcept
+{
+  __m256 rows[3][3];
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 3; ++c) {
+      rows[r][c] = _mm256_set1_ps(m[r][c]);
+    }
+  }
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 x = _mm256_loadu_ps(xs + i);
+    const __m256 y = _mm256_loadu_ps(ys + i);
+    const __m256 z = _mm256_loadu_ps(zs + i);
+
+    for (int r = 0; r < 3; ++r) {
+      __m256 ret = _mm256_mul_ps(rows[r][2], z);
+      ret = _mm256_fmadd_ps(rows[r][1], y, ret);
+      ret = _mm256_fmadd_ps(rows[r][0], x, ret);
+      _mm256_storeu_ps(out[r] + i, ret);
+    }
+  }
+
+  if (i < n) {
+    const __m256i valid = GetValidLanes(n - i);
+    const __m256 x = _mm256_maskload_ps(xs + i, valid);
+    const __m256 y = _mm256_maskload_ps(ys + i, valid);
+    const __m256 z = _mm256_maskload_ps(zs + i, valid);
+
+    for (int r = 0; r < 3; ++r) {
+      __m256 ret = _mm256_mul_ps(rows[r][2], z);
+      ret = _mm256_fmadd_ps(rows[r][1], y, ret);
+      ret = _mm256_fmadd_ps(rows[r][0], x, ret);
+      _mm256_maskstore_ps(out[r] + i, valid, ret);
+    }
+  }
+}
+
+#endif // KURO_MATH_AVX2
+
+} // namespace kuro
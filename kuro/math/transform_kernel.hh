@@ -0,0 +1,87 @@
+#ifndef KURO_MATH_TRANSFORM_KERNEL_H__
+#define KURO_MATH_TRANSFORM_KERNEL_H__
+
+#include <stddef.h>
+
+#include "matrix.hh"
+
+#if defined(__AVX2__) && defined(__FMA__) && !defined(KURO_DISABLE_SIMD)
+#include <immintrin.h>
+#define KURO_MATH_AVX2 1
+#endif
+
+namespace kuro {
+
+/*
+ * Transform the arrays of points(or vectors) by a matrix.
+ *
+ * The inputs and outputs are in structure of arrays, i.e.
+ * one array per component, such that 8 points are transformed
+ * in the AVX registers at once, and the components which are not
+ * required(e.g. w of world position) are not computed.
+ *
+ * The AVX2 kernel uses FMA, so the results may differ from the
+ * scalar kernel in the last bit.
+ */
+
+/**
+ * \brief The first row_num components of m * (xs[i], ys[i], zs[i], 1)
+ * \param out out[r][i] is the component r of point i, r in [0, row_num)
+ * \param row_num [1, 4]
+ */
+void TransformPointsScalar(Matrix4x4f const &m, float const *xs,
+                           float const *ys, float const *zs, size_t n,
+                           float *const *out, int row_num = 4) noexcept;
+
+/**
+ * \brief m * (xs[i], ys[i], zs[i])
+ *
+ * e.g. The normals transformed by GetNormalMatrix()
+ *
+ * \param out out[r][i] is the component r of vector i, r in [0, 3)
+ */
+void TransformVectorsScalar(Matrix3x3f const &m, float const *xs,
+                            float const *ys, float const *zs, size_t n,
+                            float *const *out) noexcept;
+
+#ifdef KURO_MATH_AVX2
+
+void TransformPointsAVX2(Matrix4x4f const &m, float const *xs,
+                         float const *ys, float const *zs, size_t n,
+                         float *const *out, int row_num = 4) noexcept;
+
+void TransformVectorsAVX2(Matrix3x3f const &m, float const *xs,
+                          float const *ys, float const *zs, size_t n,
+                          float *const *out) noexcept;
+
+#endif
+
+/**
+ * \brief Dispatch to the fastest kernel compiled in
+ * \see TransformPointsScalar()
+ */
+inline void TransformPoints(Matrix4x4f const &m, float const *xs,
+                            float const *ys, float const *zs, size_t n,
+                            float *const *out, int row_num = 4) noexcept
+{
+#ifdef KURO_MATH_AVX2
+  TransformPointsAVX2(m, xs, ys, zs, n, out, row_num);
+#else
+  TransformPointsScalar(m, xs, ys, zs, n, out, row_num);
+#endif
+}
+
+inline void TransformVectors(Matrix3x3f const &m, float const *xs,
+                             float const *ys, float const *zs, size_t n,
+                             float *const *out) noexcept
+{
+#ifdef KURO_MATH_AVX2
+  TransformVectorsAVX2(m, xs, ys, zs, n, out);
+#else
+  TransformVectorsScalar(m, xs, ys, zs, n, out);
+#endif
+}
+
+} // namespace kuro
+
+#endif
@@ -9,24 +9,35 @@
 
 #include "kuro/util/assert.hh"
 
+#if defined(__SSE4_1__) && !defined(KURO_DISABLE_SIMD)
+#include <immintrin.h>
+#define KURO_MATH_SSE 1
+#endif
+
+/*
+ * The intrinsics can't be evaluated at compile time,
+ * the constexpr functions with SIMD code use the generic code instead.
+ */
+#define KURO_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+
 namespace kuro {
 
 #define VEC_COMMON_DEFINITION(d)                                               \
-  Vec() noexcept = default;                                                    \
+  constexpr Vec() noexcept = default;                                          \
   ~Vec() noexcept = default;                                                   \
                                                                                \
-  size_t GetDimension() const noexcept { return d; }                           \
+  constexpr size_t GetDimension() const noexcept { return d; }                 \
                                                                                \
-  Vec(std::array<T, d> const &data)                                            \
+  constexpr Vec(std::array<T, d> const &data)                                  \
   {                                                                            \
-    for (size_t i = 0; i < data_.size(); ++i) {                                \
+    for (size_t i = 0; i < d; ++i) {                                           \
       data_[i] = data[i];                                                      \
     }                                                                          \
   }                                                                            \
                                                                                \
-  T &operator[](size_t i) noexcept { return data_[i]; }                        \
+  constexpr T &operator[](size_t i) noexcept { return data_[i]; }              \
                                                                                \
-  T const &operator[](size_t i) const noexcept { return data_[i]; }            \
+  constexpr T const &operator[](size_t i) const noexcept { return data_[i]; }  \
                                                                                \
   float len() const noexcept                                                   \
   {                                                                            \
@@ -59,7 +70,7 @@ namespace kuro {
     std::cout << data_[d - 1] << ")\n";                                        \
   }                                                                            \
                                                                                \
-  Vec &operator+=(Vec const &rhs) noexcept                                     \
+  constexpr Vec &operator+=(Vec const &rhs) noexcept                           \
   {                                                                            \
     for (size_t i = 0; i < d; ++i) {                                           \
       data_[i] += rhs[i];                                                      \
@@ -67,16 +78,16 @@ namespace kuro {
     return *this;                                                              \
   }                                                                            \
                                                                                \
-  void MakeZero() noexcept                                                     \
+  constexpr void MakeZero() noexcept                                           \
   {                                                                            \
     for (size_t i = 0; i < d; ++i) {                                           \
       data_[i] = 0;                                                            \
     }                                                                          \
   }                                                                            \
                                                                                \
-  void Fill(T val) noexcept                                                    \
+  constexpr void Fill(T val) noexcept                                          \
   {                                                                            \
-    for (int i = 0; i < d; ++i) {                                              \
+    for (size_t i = 0; i < d; ++i) {                                           \
       data_[i] = val;                                                          \
     }                                                                          \
   }
@@ -88,67 +99,65 @@ class Vec {
  public:
   VEC_COMMON_DEFINITION(N)
  private:
-  std::array<T, N> data_;
+  std::array<T, N> data_{};
 };
 
 template <typename T>
 class Vec<T, 2> {
  public:
-  Vec(T x, T y)
+  constexpr Vec(T x, T y)
+    : data_{ { x, y } }
   {
-    data_[0] = x;
-    data_[1] = y;
   }
 
   VEC_COMMON_DEFINITION(2)
 
-  T x() const noexcept { return data_[0]; }
-  T y() const noexcept { return data_[1]; }
+  constexpr T x() const noexcept { return data_[0]; }
+  constexpr T y() const noexcept { return data_[1]; }
 
  private:
-  std::array<T, 2> data_;
+  std::array<T, 2> data_{};
 };
 
 template <typename T>
 class Vec<T, 3> {
  public:
-  Vec(T x, T y, T z)
+  constexpr Vec(T x, T y, T z)
+    : data_{ { x, y, z, T{} } }
   {
-    data_[0] = x;
-    data_[1] = y;
-    data_[2] = z;
   }
 
   VEC_COMMON_DEFINITION(3)
 
-  T x() const noexcept { return data_[0]; }
-  T y() const noexcept { return data_[1]; }
-  T z() const noexcept { return data_[2]; }
+  constexpr T x() const noexcept { return data_[0]; }
+  constexpr T y() const noexcept { return data_[1]; }
+  constexpr T z() const noexcept { return data_[2]; }
 
  private:
-  std::array<T, 3> data_;
+  /*
+   * Padded to 4 elements, such that Vec3f can be loaded
+   * to a SSE register. The padding is zero.
+   */
+  alignas(4 * sizeof(T)) std::array<T, 4> data_{};
 };
 
 template <typename T>
 class Vec<T, 4> {
  public:
-  Vec(T x, T y, T z, T w)
+  constexpr Vec(T x, T y, T z, T w)
+    : data_{ { x, y, z, w } }
   {
-    data_[0] = x;
-    data_[1] = y;
-    data_[2] = z;
-    data_[3] = w;
   }
 
   VEC_COMMON_DEFINITION(4)
 
-  T x() const noexcept { return data_[0]; }
-  T y() const noexcept { return data_[1]; }
-  T z() const noexcept { return data_[2]; }
-  T w() const noexcept { return data_[3]; }
+  constexpr T x() const noexcept { return data_[0]; }
+  constexpr T y() const noexcept { return data_[1]; }
+  constexpr T z() const noexcept { return data_[2]; }
+  constexpr T w() const noexcept { return data_[3]; }
 
  private:
-  std::array<T, 4> data_;
+  alignas(4 * sizeof(T)) std::array<T, 4> data_{};
 };
 
 /* Convenient alias */
@@ -159,8 +168,57 @@ using Vec2f = Vec<float, 2>;
 using Vec3f = Vec<float, 3>;
 using Vec4f = Vec<float, 4>;
 
+#ifdef KURO_MATH_SSE
+
+inline __m128 LoadVec(Vec3f const &v) noexcept { return _mm_load_ps(&v[0]); }
+inline __m128 LoadVec(Vec4f const &v) noexcept { return _mm_load_ps(&v[0]); }
+
+template <typename V>
+inline V StoreVec(__m128 m) noexcept
+{
+  V ret;
+  _mm_store_ps(&ret[0], m);
+  return ret;
+}
+
+/*
+ * The mask of _mm_dp_ps(), i.e. multiply the first d lanes and
+ * broadcast the sum, the padding of Vec3f is ignored
+ */
+#define VEC_SSE_DOT_MASK(d) (((1 << d) - 1) << 4 | 0xF)
+
+template <>
+inline float Vec<float, 3>::len() const noexcept
+{
+  const __m128 v = LoadVec(*this);
+  return _mm_cvtss_f32(_mm_sqrt_ss(_mm_dp_ps(v, v, VEC_SSE_DOT_MASK(3))));
+}
+
+template <>
+inline float Vec<float, 4>::len() const noexcept
+{
+  const __m128 v = LoadVec(*this);
+  return _mm_cvtss_f32(_mm_sqrt_ss(_mm_dp_ps(v, v, VEC_SSE_DOT_MASK(4))));
+}
+
+template <>
+inline Vec<float, 3> Vec<float, 3>::Normalize() const noexcept
+{
+  const __m128 v = LoadVec(*this);
+  return StoreVec<Vec3f>(_mm_div_ps(v, _mm_sqrt_ps(_mm_dp_ps(v, v, VEC_SSE_DOT_MASK(3)))));
+}
+
+template <>
+inline Vec<float, 4> Vec<float, 4>::Normalize() const noexcept
+{
+  const __m128 v = LoadVec(*this);
+  return StoreVec<Vec4f>(_mm_div_ps(v, _mm_sqrt_ps(_mm_dp_ps(v, v, VEC_SSE_DOT_MASK(4)))));
+}
+
+#endif // KURO_MATH_SSE
+
 template <typename T>
-Vec<T, 3> CrossProduct3(Vec<T, 3> const &a, Vec<T, 3> const &b) noexcept
+constexpr Vec<T, 3> CrossProduct3(Vec<T, 3> const &a, Vec<T, 3> const &b) noexcept
 {
   /*
    * a x b =
@@ -173,7 +231,7 @@ Vec<T, 3> CrossProduct3(Vec<T, 3> const &a, Vec<T, 3> const &b) noexcept
 }
 
 template <typename T, size_t N>
-Vec<float, N> ToVecf(Vec<T, N> const &a) noexcept
+constexpr Vec<float, N> ToVecf(Vec<T, N> const &a) noexcept
 {
   Vec<float, N> ret;
   for (size_t i = 0; i < N; ++i)
@@ -182,7 +240,7 @@ Vec<float, N> ToVecf(Vec<T, N> const &a) noexcept
 }
 
 template <typename T, size_t N>
-Vec<int, N> ToVeci(Vec<T, N> const &v) noexcept
+constexpr Vec<int, N> ToVeci(Vec<T, N> const &v) noexcept
 {
   Vec<int, N> ret;
   for (size_t i = 0; i < N; ++i) {
@@ -191,7 +249,7 @@ Vec<int, N> ToVeci(Vec<T, N> const &v) noexcept
   return ret;
 }
 template <typename T, size_t N>
-T DotProduct(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
+constexpr T DotProduct(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
 {
   T ret{};
   for (size_t i = 0; i < N; ++i) {
@@ -201,15 +259,15 @@ T DotProduct(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
 }
 
 template <typename T, size_t N>
-bool IsOrthogonal(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
+constexpr bool IsOrthogonal(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
 {
   return DotProduct(a, b) == 0;
 }
 
 template <typename T, size_t N>
-Vec<T, N> operator-(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
+constexpr Vec<T, N> operator-(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
 {
-  std::array<T, N> data;
+  std::array<T, N> data{};
   for (size_t i = 0; i < N; ++i) {
     data[i] = a[i] - b[i];
   }
@@ -218,7 +276,7 @@ Vec<T, N> operator-(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
 }
 
 template <typename T, size_t N>
-Vec<T, N> operator-(Vec<T, N> const &a) noexcept
+constexpr Vec<T, N> operator-(Vec<T, N> const &a) noexcept
 {
   Vec<T, N> ret;
   for (size_t i = 0; i < N; ++i)
@@ -227,9 +285,9 @@ Vec<T, N> operator-(Vec<T, N> const &a) noexcept
 }
 
 template <typename T, size_t N>
-Vec<T, N> operator+(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
+constexpr Vec<T, N> operator+(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
 {
-  std::array<T, N> data;
+  std::array<T, N> data{};
   for (size_t i = 0; i < N; ++i) {
     data[i] = a[i] + b[i];
   }
@@ -240,7 +298,7 @@ Vec<T, N> operator+(Vec<T, N> const &a, Vec<T, N> const &b) noexcept
 template <
     typename T, size_t N, typename U,
     typename = typename std::enable_if<std::is_convertible<U, T>::value>::type>
-inline Vec<T, N> operator/(Vec<T, N> const &a, U d) noexcept
+constexpr Vec<T, N> operator/(Vec<T, N> const &a, U d) noexcept
 {
   Vec<T, N> ret;
   for (size_t i = 0; i < N; ++i) {
@@ -252,7 +310,7 @@ inline Vec<T, N> operator/(Vec<T, N> const &a, U d) noexcept
 template <
     typename T, size_t N, typename U,
     typename = typename std::enable_if<std::is_convertible<U, T>::value>::type>
-inline Vec<T, N> operator/(U d, Vec<T, N> const &a) noexcept
+constexpr Vec<T, N> operator/(U d, Vec<T, N> const &a) noexcept
 {
   Vec<T, N> ret;
   for (size_t i = 0; i < N; ++i) {
@@ -262,7 +320,7 @@ inline Vec<T, N> operator/(U d, Vec<T, N> const &a) noexcept
 }
 
 template <typename T, size_t N>
-inline Vec<T, N> operator*(Vec<T, N> const &a, T m) noexcept
+constexpr Vec<T, N> operator*(Vec<T, N> const &a, T m) noexcept
 {
   Vec<T, N> ret;
   for (size_t i = 0; i < N; ++i) {
@@ -273,7 +331,7 @@ inline Vec<T, N> operator*(Vec<T, N> const &a, T m) noexcept
 
 // TODO Use TMP optimization
 template <size_t N, size_t F, typename T>
-Vec<T, N> ClipVec(Vec<T, F> const &v) noexcept
+constexpr Vec<T, N> ClipVec(Vec<T, F> const &v) noexcept
 {
   static_assert(N < F, "");
   Vec<T, N> ret;
@@ -284,7 +342,7 @@ Vec<T, N> ClipVec(Vec<T, F> const &v) noexcept
 }
 
 template <size_t N, size_t F, typename T>
-Vec<T, N> EmbedVec(Vec<T, F> const &v, T e) noexcept
+constexpr Vec<T, N> EmbedVec(Vec<T, F> const &v, T e) noexcept
 {
   static_assert(N > F, "");
   Vec<T, N> ret;
@@ -299,11 +357,95 @@ Vec<T, N> EmbedVec(Vec<T, F> const &v, T e) noexcept
 }
 
 template <size_t N, size_t F>
-inline Vec<float, N> EmbedVecf(Vec<float, F> const &v, float e) noexcept
+constexpr Vec<float, N> EmbedVecf(Vec<float, F> const &v, float e) noexcept
 {
   return EmbedVec<N, F, float>(v, e);
 }
 
+/**
+ * \brief Normalize by the approximate reciprocal square root
+ *
+ * The error is a few ulp, use it if the exact length is not required,
+ * e.g. the normal in lighting.
+ */
+template <typename T, size_t N>
+inline Vec<float, N> FastNormalize(Vec<T, N> const &v) noexcept
+{
+  return v.Normalize();
+}
+
+#ifdef KURO_MATH_SSE
+
+/*
+ * The overloads of Vec3f and Vec4f are prefered to the templates.
+ * The results are same with the generic ones except
+ * the rounding of the sum in DotProduct().
+ */
+#define VEC_SSE_DEFINITION(d)                                                  \
+  constexpr Vec<float, d> operator+(Vec<float, d> const &a,                    \
+                                    Vec<float, d> const &b) noexcept           \
+  {                                                                            \
+    if (KURO_IS_CONSTANT_EVALUATED()) return operator+<float, d>(a, b);       \
+    return StoreVec<Vec<float, d>>(_mm_add_ps(LoadVec(a), LoadVec(b)));        \
+  }                                                                            \
+                                                                               \
+  constexpr Vec<float, d> operator-(Vec<float, d> const &a,                    \
+                                    Vec<float, d> const &b) noexcept           \
+  {                                                                            \
+    if (KURO_IS_CONSTANT_EVALUATED()) return operator-<float, d>(a, b);       \
+    return StoreVec<Vec<float, d>>(_mm_sub_ps(LoadVec(a), LoadVec(b)));        \
+  }                                                                            \
+                                                                               \
+  constexpr Vec<float, d> operator-(Vec<float, d> const &a) noexcept           \
+  {                                                                            \
+    if (KURO_IS_CONSTANT_EVALUATED()) return operator-<float, d>(a);          \
+    return StoreVec<Vec<float, d>>(_mm_sub_ps(_mm_setzero_ps(), LoadVec(a)));  \
+  }                                                                            \
+                                                                               \
+  constexpr Vec<float, d> operator*(Vec<float, d> const &a, float m) noexcept  \
+  {                                                                            \
+    if (KURO_IS_CONSTANT_EVALUATED()) return operator*<float, d>(a, m);       \
+    return StoreVec<Vec<float, d>>(_mm_mul_ps(LoadVec(a), _mm_set1_ps(m)));    \
+  }                                                                            \
+                                                                               \
+  constexpr float DotProduct(Vec<float, d> const &a,                           \
+                             Vec<float, d> const &b) noexcept                  \
+  {                                                                            \
+    if (KURO_IS_CONSTANT_EVALUATED()) return DotProduct<float, d>(a, b);      \
+    return _mm_cvtss_f32(_mm_dp_ps(LoadVec(a), LoadVec(b), VEC_SSE_DOT_MASK(d))); \
+  }                                                                            \
+                                                                               \
+  inline Vec<float, d> FastNormalize(Vec<float, d> const &v) noexcept          \
+  {                                                                            \
+    const __m128 x = LoadVec(v);                                               \
+    const __m128 sum = _mm_dp_ps(x, x, VEC_SSE_DOT_MASK(d));                   \
+    /* One Newton-Raphson step: r = r * (1.5 - 0.5 * sum * r * r) */           \
+    __m128 r = _mm_rsqrt_ps(sum);                                              \
+    r = _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f),                            \
+        _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), sum), _mm_mul_ps(r, r))));    \
+    return StoreVec<Vec<float, d>>(_mm_mul_ps(x, r));                          \
+  }
+
+VEC_SSE_DEFINITION(3)
+VEC_SSE_DEFINITION(4)
+
+constexpr Vec3f CrossProduct3(Vec3f const &a, Vec3f const &b) noexcept
+{
+  if (KURO_IS_CONSTANT_EVALUATED()) return CrossProduct3<float>(a, b);
+
+  // (y, z, x) of a and b, the padding is kept in the last lane
+  const __m128 va = LoadVec(a);
+  const __m128 vb = LoadVec(b);
+  const __m128 a_yzx = _mm_shuffle_ps(va, va, _MM_SHUFFLE(3, 0, 2, 1));
+  const __m128 b_yzx = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(3, 0, 2, 1));
+
+  // (z, x, y) of a x b
+  const __m128 c = _mm_sub_ps(_mm_mul_ps(va, b_yzx), _mm_mul_ps(a_yzx, vb));
+  return StoreVec<Vec3f>(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+}
+
+#endif // KURO_MATH_SSE
+
 } // namespace kuro
 
 #endif
@@ -8,6 +8,15 @@ namespace kuro {
 
 struct Option {
   std::vector<std::string> models;
+
+  /* The number of threads rendering and parsing models, <= 0 means hardware concurrency */
+  int threads = 0;
+
+  /* The faces culled: none, back, front */
+  std::string cull = "back";
+
+  /* The directory of mesh caches, empty means next to the models */
+  std::string cache_dir;
 };
 
 inline Option &kuro_option()
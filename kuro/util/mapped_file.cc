@@ -0,0 +1,55 @@
+#include "mapped_file.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace kuro;
+
+MappedFile::~MappedFile() noexcept
+{
+  Close();
+}
+
+bool MappedFile::Open(char const *path) noexcept
+{
+  Close();
+
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  size_ = (size_t)st.st_size;
+  if (size_ > 0) {
+    void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      size_ = 0;
+      return false;
+    }
+    // The file is scanned from begin to end
+    ::madvise(addr, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<char const *>(addr);
+  }
+
+  // The mapping is still valid after closing the file descriptor
+  ::close(fd);
+  valid_ = true;
+  return true;
+}
+
+void MappedFile::Close() noexcept
+{
+  if (data_) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  valid_ = false;
+}
@@ -0,0 +1,41 @@
+#ifndef KURO_UTIL_MAPPED_FILE_H__
+#define KURO_UTIL_MAPPED_FILE_H__
+
+#include <stddef.h>
+
+#include "kuro/util/noncopyable.hh"
+
+namespace kuro {
+
+/**
+ * Map the whole file into memory(read only) in RAII style
+ *
+ * The pages are loaded on demand by the OS, so the contents can be
+ * scanned in place without copying them to a buffer.
+ * \warning The contents are not terminated by '\0'
+ */
+class MappedFile : kanon::noncopyable {
+ public:
+  MappedFile() = default;
+  ~MappedFile() noexcept;
+
+  /**
+   * \return
+   *  true -- Success(The empty file is mapped to an empty range)
+   */
+  bool Open(char const *path) noexcept;
+  void Close() noexcept;
+
+  char const *GetData() const noexcept { return data_; }
+  size_t GetSize() const noexcept { return size_; }
+  bool IsValid() const noexcept { return valid_; }
+
+ private:
+  char const *data_ = nullptr;
+  size_t size_ = 0;
+  bool valid_ = false;
+};
+
+} // namespace kuro
+
+#endif
@@ -0,0 +1,90 @@
+#include "thread_pool.hh"
+
+using namespace kuro;
+
+ThreadPool::ThreadPool(int thread_num)
+{
+  if (thread_num <= 0) {
+    thread_num = (int)std::thread::hardware_concurrency();
+    if (thread_num <= 0) thread_num = 1;
+  }
+
+  workers_.reserve(thread_num - 1);
+  for (int i = 1; i < thread_num; ++i) {
+    workers_.emplace_back([this]() {
+      WorkerLoop();
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept
+{
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    quit_ = true;
+  }
+  start_cond_.notify_all();
+
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t n, Task const &task)
+{
+  if (n == 0) return;
+
+  if (workers_.empty() || n == 1) {
+    for (size_t i = 0; i < n; ++i)
+      task(i);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    task_ = &task;
+    task_num_ = n;
+    next_index_.store(0, std::memory_order_relaxed);
+    running_num_ = (int)workers_.size();
+    ++generation_;
+  }
+  start_cond_.notify_all();
+
+  RunTasks();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cond_.wait(lock, [this]() { return running_num_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+  size_t generation = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cond_.wait(lock, [this, generation]() {
+        return quit_ || generation_ != generation;
+      });
+      if (quit_) return;
+      generation = generation_;
+    }
+
+    RunTasks();
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (--running_num_ == 0) {
+      done_cond_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::RunTasks()
+{
+  for (;;) {
+    const auto i = next_index_.fetch_add(1, std::memory_order_relaxed);
+    if (i >= task_num_) break;
+    (*task_)(i);
+  }
+}
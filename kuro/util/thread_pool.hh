@@ -0,0 +1,74 @@
+#ifndef KURO_UTIL_THREAD_POOL_H__
+#define KURO_UTIL_THREAD_POOL_H__
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "kuro/util/noncopyable.hh"
+
+namespace kuro {
+
+/**
+ * \brief Fixed-size worker pool for data parallel loops
+ *
+ * The workers are created once and sleep between two loops,
+ * so the pool can be used per frame without paying the cost of
+ * creating threads.
+ *
+ * The caller thread also takes part in the loop, hence
+ * ThreadPool(1) runs everything in the caller thread.
+ */
+class ThreadPool : kanon::noncopyable {
+ public:
+  using Task = std::function<void(size_t)>;
+
+  /**
+   * \param thread_num The number of threads participating the loop
+   *                   (including the caller thread).
+   *                   <= 0 means std::thread::hardware_concurrency().
+   */
+  explicit ThreadPool(int thread_num = 0);
+  ~ThreadPool() noexcept;
+
+  /**
+   * \brief Call task(i) for every i in [0, n)
+   *
+   * The indexes are dispatched dynamically, so the tasks
+   * can have different costs.
+   * Return after all tasks are completed.
+   *
+   * \warning Not reentrant, don't call it in the task
+   */
+  void ParallelFor(size_t n, Task const &task);
+
+  int GetThreadNum() const noexcept { return (int)workers_.size() + 1; }
+
+ private:
+  void WorkerLoop();
+  void RunTasks();
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable start_cond_;
+  std::condition_variable done_cond_;
+
+  Task const *task_ = nullptr;
+  size_t task_num_ = 0;
+  std::atomic<size_t> next_index_{0};
+
+  /* Identify the loop that workers have joined */
+  size_t generation_ = 0;
+  int running_num_ = 0;
+  bool quit_ = false;
+};
+
+} // namespace kuro
+
+#endif
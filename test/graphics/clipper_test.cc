@@ -0,0 +1,62 @@
+#include "kuro/graphics/clipper.hh"
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+static FragmentContext MakeVertex(float x, float y, float z, float w)
+{
+  FragmentContext fctx{};
+  fctx.clip_pos = Vec4f(x, y, z, w);
+  fctx.SetVarying(0, Vec2f(z, w));
+  return fctx;
+}
+
+TEST (clipper_test, in_guard_band) {
+  ClipPolygon polygon;
+  // x = 4 is out of screen but in the guard band
+  EXPECT_TRUE(ClipTriangle({ MakeVertex(0, 0, 0, -1), MakeVertex(4, 0, 0, -1),
+                             MakeVertex(0, 1, 0, -1) }, polygon));
+  EXPECT_EQ(polygon.num, 3);
+}
+
+TEST (clipper_test, out_of_frustum) {
+  ClipPolygon polygon;
+  EXPECT_FALSE(ClipTriangle({ MakeVertex(2, 0, 0, -1), MakeVertex(3, 0, 0, -1),
+                              MakeVertex(2, 1, 0, -1) }, polygon));
+  // Behind the camera
+  EXPECT_FALSE(ClipTriangle({ MakeVertex(0, 0, -1, 1), MakeVertex(1, 0, -1, 1),
+                              MakeVertex(0, 1, -1, 1) }, polygon));
+}
+
+TEST (clipper_test, cross_far_plane) {
+  ClipPolygon polygon;
+  // The first vertex is beyond the far plane(z > -w)
+  ASSERT_TRUE(ClipTriangle({ MakeVertex(0, 0, 2, -1), MakeVertex(-0.5, 0, 0, -1),
+                             MakeVertex(0.5, 0.5, 0, -1) }, polygon, 2));
+  ASSERT_EQ(polygon.num, 4);
+
+  for (int i = 0; i < polygon.num; ++i) {
+    auto const &v = polygon.vertexes[i];
+    EXPECT_LE(v.clip_pos.z(), -v.clip_pos.w() + 1e-6f);
+    // The attributes are interpolated with clip_pos
+    EXPECT_FLOAT_EQ(v.varyings[0], v.clip_pos.z());
+    EXPECT_FLOAT_EQ(v.varyings[1], v.clip_pos.w());
+  }
+}
+
+TEST (clipper_test, cross_near_plane) {
+  ClipPolygon polygon;
+  // The first vertex is in front of the near plane(z < w)
+  ASSERT_TRUE(ClipTriangle({ MakeVertex(0, 0, -2, -1), MakeVertex(-0.5, 0, 0, -1),
+                             MakeVertex(0.5, 0.5, 0, -1) }, polygon, 2));
+  ASSERT_EQ(polygon.num, 4);
+
+  for (int i = 0; i < polygon.num; ++i) {
+    auto const &v = polygon.vertexes[i];
+    EXPECT_GE(v.clip_pos.z(), v.clip_pos.w() - 1e-6f);
+    EXPECT_LT(v.clip_pos.w(), 0);
+    EXPECT_FLOAT_EQ(v.varyings[0], v.clip_pos.z());
+    EXPECT_FLOAT_EQ(v.varyings[1], v.clip_pos.w());
+  }
+}
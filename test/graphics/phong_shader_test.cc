@@ -0,0 +1,187 @@
+#include "kuro/graphics/phong_shader.hh"
+#include "kuro/graphics/flat_shader.hh"
+#include "kuro/graphics/rasterizer.hh"
+#include "kuro/graphics/transform.hh"
+#include "kuro/img/model.hh"
+#include "kuro/math/util.hh"
+
+#include <math.h>
+#include <atomic>
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+static constexpr int RING_NUM = 16;
+static constexpr int SEGMENT_NUM = 32;
+static constexpr float PI = 3.14159265f;
+
+/*
+ * The unit sphere, the vertex (i, j) is in the segment i and ring j:
+ * u = i / SEGMENT_NUM, v = 1 - j / RING_NUM,
+ * u = 0.5 faces +Z and the seam(u = 0 or 1) is in -Z.
+ * The normal is same with the position.
+ */
+static void BuildSphere(Model &model)
+{
+  for (int j = 0; j <= RING_NUM; ++j) {
+    const float theta = PI * j / RING_NUM;
+    for (int i = 0; i <= SEGMENT_NUM; ++i) {
+      const float u = (float)i / SEGMENT_NUM;
+      const float phi = 2 * PI * (u - 0.5f);
+      const Vec3f pos(sinf(theta) * sinf(phi), cosf(theta), sinf(theta) * cosf(phi));
+      model.vertexes().push_back(pos);
+      model.normals().push_back(pos);
+      model.textures().push_back(Vec3f(u, 1 - (float)j / RING_NUM, 0));
+    }
+  }
+
+  auto mesh = [](int i, int j) {
+    const int idx = j * (SEGMENT_NUM + 1) + i;
+    return Model::Mesh{ idx, idx, idx };
+  };
+
+  // CCW from outside
+  for (int j = 0; j < RING_NUM; ++j) {
+    for (int i = 0; i < SEGMENT_NUM; ++i) {
+      model.triangles().push_back({ mesh(i, j), mesh(i, j+1), mesh(i+1, j+1) });
+      model.triangles().push_back({ mesh(i, j), mesh(i+1, j+1), mesh(i+1, j) });
+    }
+  }
+
+  model.vertex_buffer().Build(model);
+  model.vertex_buffer().Optimize();
+}
+
+template <typename Shader>
+static void SetupCamera(Shader &shader, Vec3f eye, int w, int h)
+{
+  shader.varying_model_matrix = GetIdentityF<4>();
+  shader.varying_view_matrix = GetViewMatrix(Vec3f(0, 0, 0), eye, Vec3f(0, 1, 0));
+  shader.varying_projection_matrix =
+      GetProjectionMatrix(-0.1f, -100, AngleToRadian(60), (float)w / h);
+  shader.uniform_light_dir = Vec3f(0, 0, -1);
+}
+
+/*
+ * The interpolated varyings of every fragment agree with the sphere:
+ * the normal is the direction of world position,
+ * and the uv is the spherical coordinate of it.
+ * The error of tessellation is less than a segment.
+ */
+TEST (phong_shader_test, varyings) {
+  const int w = 200, h = 200;
+  FrameBuffer buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+  Model model;
+  BuildSphere(model);
+
+  class CheckShader : public PhongShader {
+   public:
+    bool FragmentProcess(FragmentContext &fctx, FrameColor &color) override
+    {
+      const auto normal = fctx.GetVarying<3>(GetNormalOffset()).Normalize();
+      const auto world_pos = fctx.GetVarying<3>(GetWorldPosOffset());
+      const auto uv = fctx.GetVarying<2>(GetUvOffset());
+      const auto dir = world_pos.Normalize();
+
+      EXPECT_GT(DotProduct(normal, dir), cosf(PI / RING_NUM));
+      EXPECT_GT(world_pos.z(), 0) << "The back faces are culled";
+
+      // The longitude is unstable near the poles
+      if (fabsf(dir.y()) < 0.9f) {
+        EXPECT_NEAR(uv.x(), atan2f(dir.x(), dir.z()) / (2 * PI) + 0.5f, 1.f / SEGMENT_NUM);
+      }
+      EXPECT_NEAR(uv.y(), 1 - acosf(dir.y()) / PI, 1.f / RING_NUM);
+
+      ++count;
+      return PhongShader::FragmentProcess(fctx, color);
+    }
+
+    std::atomic<int> count{0};
+  } shader;
+
+  const Vec3f eye(0, 0, 3);
+  SetupCamera(shader, eye, w, h);
+  shader.uniform_eye_pos = eye;
+
+  Rasterizer rasterizer(&model, &shader, 2);
+  rasterizer.Render(buffer);
+  EXPECT_GT(shader.count, w * h / 8);
+}
+
+/*
+ * The interpolated normal shades the sphere smoothly,
+ * the steps between the adjacent pixels are much smaller than FlatShader
+ */
+TEST (phong_shader_test, smooth_shading) {
+  const int w = 200, h = 200;
+  Model model;
+  BuildSphere(model);
+  const Vec3f eye(0, 0, 3);
+
+  // The lighting changes quickly near the silhouette, so the middle half only
+  auto get_max_step = [&](FrameBuffer &buffer) {
+    int max_step = 0;
+    const int y = h / 2 + 7;
+    for (int x = w / 4; x < w * 3 / 4; ++x) {
+      const int a = buffer.GetPixel(x, y).r;
+      const int b = buffer.GetPixel(x + 1, y).r;
+      max_step = std::max(max_step, abs(a - b));
+    }
+    return max_step;
+  };
+
+  FrameBuffer phong_buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+  PhongShader phong;
+  SetupCamera(phong, eye, w, h);
+  phong.uniform_eye_pos = eye;
+  phong.uniform_specular = 0;
+  Rasterizer(&model, &phong, 2).Render(phong_buffer);
+
+  FrameBuffer flat_buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+  FlatShader flat;
+  SetupCamera(flat, eye, w, h);
+  BasicRasterizer<FlatShader>(&model, &flat, 2).Render(flat_buffer);
+
+  // Facing the light
+  EXPECT_GT(phong_buffer.GetPixel(w / 2, h / 2).r, 240);
+
+  const int phong_step = get_max_step(phong_buffer);
+  const int flat_step = get_max_step(flat_buffer);
+  EXPECT_GT(flat_step, 10);
+  EXPECT_LT(phong_step * 3, flat_step);
+}
+
+/*
+ * The albedo of the odd cells of checkerboard is halved
+ */
+TEST (phong_shader_test, checker) {
+  const int w = 200, h = 200;
+  Model model;
+  BuildSphere(model);
+  const Vec3f eye(0, 0, 3);
+
+  FrameBuffer buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+  PhongShader shader;
+  SetupCamera(shader, eye, w, h);
+  shader.uniform_eye_pos = eye;
+  shader.uniform_specular = 0;
+  shader.uniform_ambient = 0;
+  shader.uniform_checker_num = 4;
+
+  Rasterizer(&model, &shader, 2).Render(buffer);
+
+  /*
+   * The center of sphere is u = v = 0.5, i.e. in the corner of 4 cells,
+   * the diagonal neighbours are in the cells of same parity
+   */
+  const int d = 8;
+  const int x0 = w / 2, y0 = h / 2;
+  const int c00 = buffer.GetPixel(x0 - d, y0 - d).r;
+  const int c11 = buffer.GetPixel(x0 + d, y0 + d).r;
+  const int c01 = buffer.GetPixel(x0 - d, y0 + d).r;
+  const int c10 = buffer.GetPixel(x0 + d, y0 - d).r;
+  EXPECT_NEAR(c00, c11, 4);
+  EXPECT_NEAR(c01, c10, 4);
+  EXPECT_NEAR(std::max(c00, c01), 2 * std::min(c00, c01), 8);
+}
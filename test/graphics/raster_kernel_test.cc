@@ -0,0 +1,66 @@
+#include "kuro/graphics/raster_kernel.hh"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+#ifdef KURO_RASTER_AVX2
+TEST (raster_kernel_test, avx2_is_bit_exact) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-2, 2);
+  std::uniform_int_distribution<int32_t> idist(-1000, 1000);
+
+  SpanOffsets offsets;
+  float zbuffer[KURO_SPAN_WIDTH];
+  float scalar_depth[KURO_SPAN_WIDTH];
+  float simd_depth[KURO_SPAN_WIDTH];
+
+  for (int round = 0; round < 10000; ++round) {
+    int32_t a[3] = { idist(gen), idist(gen), idist(gen) };
+    float za = dist(gen) / 100;
+    for (int lane = 0; lane < KURO_SPAN_WIDTH; ++lane) {
+      for (int i = 0; i < 3; ++i)
+        offsets.edges[i][lane] = lane * a[i];
+      offsets.depth[lane] = lane * za;
+      zbuffer[lane] = dist(gen) / 4;
+    }
+
+    int32_t e[3] = { idist(gen) * 4, idist(gen) * 4, idist(gen) * 4 };
+    float z = dist(gen) / 4;
+    int lane_num = round % KURO_SPAN_WIDTH + 1;
+
+    auto scalar_mask = ComputeSpanMaskScalar(offsets, e, z, zbuffer, lane_num, scalar_depth);
+    auto simd_mask = ComputeSpanMaskAVX2(offsets, e, z, zbuffer, lane_num, simd_depth);
+
+    ASSERT_EQ(scalar_mask, simd_mask);
+    for (int lane = 0; lane < lane_num; ++lane)
+      ASSERT_EQ(scalar_depth[lane], simd_depth[lane]);
+
+    // Some lanes are equal in the shading pass after depth pre-pass
+    for (int lane = 0; lane < lane_num; lane += 2)
+      zbuffer[lane] = scalar_depth[lane];
+
+    scalar_mask = ComputeSpanMaskScalar(offsets, e, z, zbuffer, lane_num, scalar_depth, DEPTH_FUNC_EQUAL);
+    simd_mask = ComputeSpanMaskAVX2(offsets, e, z, zbuffer, lane_num, simd_depth, DEPTH_FUNC_EQUAL);
+    ASSERT_EQ(scalar_mask, simd_mask);
+  }
+}
+#endif
+
+TEST (raster_kernel_test, partial_span) {
+  SpanOffsets offsets;
+  float zbuffer[KURO_SPAN_WIDTH];
+  float depth[KURO_SPAN_WIDTH];
+  for (int lane = 0; lane < KURO_SPAN_WIDTH; ++lane) {
+    for (int i = 0; i < 3; ++i)
+      offsets.edges[i][lane] = 0;
+    offsets.depth[lane] = 0;
+    zbuffer[lane] = -1;
+  }
+
+  int32_t e[3] = { 0, 1, 1 };
+  EXPECT_EQ(ComputeSpanMask(offsets, e, 0, zbuffer, 3, depth), 0x7u);
+  EXPECT_EQ(ComputeSpanMask(offsets, e, -2, zbuffer, 8, depth), 0u);
+}
@@ -0,0 +1,260 @@
+#include "kuro/graphics/triangle.hh"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+class CountShader : public ShaderInterface {
+ public:
+  FragmentContext VertexProcess(VertexContext &vctx) override
+  {
+    return FragmentContext{};
+  }
+
+  bool FragmentProcess(FragmentContext &fctx, FrameColor &color) override
+  {
+    ++count;
+    // Don't update depth, so the overdraw can be detected
+    return false;
+  }
+
+  int count = 0;
+};
+
+static FragmentContext MakeVertex(float x, float y, int w, int h, float z = 0)
+{
+  FragmentContext fctx;
+  // The visible points have negative w
+  fctx.clip_pos = Vec4f(1 - x * 2 / w, 1 - y * 2 / h, -z, -1);
+  return fctx;
+}
+
+/*
+ * Tessellate a rectangle to triangles whose shared edges go through
+ * the pixel centers, every pixel center in it must be shaded once.
+ */
+TEST (triangle_test, shared_edge_shaded_once) {
+  const int w = 100;
+  const int h = 100;
+  FrameBuffer buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+  CountShader shader;
+
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> jitter(-2, 2);
+
+  // Rectangle [20, 80] x [20, 80], 6x6 cells
+  const int cells = 6;
+  float xs[cells+1][cells+1];
+  float ys[cells+1][cells+1];
+  for (int i = 0; i <= cells; ++i) {
+    for (int j = 0; j <= cells; ++j) {
+      xs[i][j] = 20 + i * 10;
+      ys[i][j] = 20 + j * 10;
+      if (i != 0 && i != cells && j != 0 && j != cells) {
+        // Put the interior vertexes in the pixel centers
+        xs[i][j] += jitter(gen) + 0.5f;
+        ys[i][j] += jitter(gen) + 0.5f;
+      }
+    }
+  }
+
+  for (int i = 0; i < cells; ++i) {
+    for (int j = 0; j < cells; ++j) {
+      auto v00 = MakeVertex(xs[i][j], ys[i][j], w, h);
+      auto v10 = MakeVertex(xs[i+1][j], ys[i+1][j], w, h);
+      auto v01 = MakeVertex(xs[i][j+1], ys[i][j+1], w, h);
+      auto v11 = MakeVertex(xs[i+1][j+1], ys[i+1][j+1], w, h);
+
+      // Mix the winding and diagonal direction
+      if ((i + j) % 2) {
+        DrawTriangle({ v00, v10, v11 }, &shader, buffer);
+        DrawTriangle({ v00, v01, v11 }, &shader, buffer);
+      } else {
+        DrawTriangle({ v00, v10, v01 }, &shader, buffer);
+        DrawTriangle({ v10, v11, v01 }, &shader, buffer);
+      }
+    }
+  }
+
+  EXPECT_EQ(shader.count, 60 * 60);
+}
+
+TEST (triangle_test, sliver) {
+  const int w = 100;
+  const int h = 100;
+  FrameBuffer buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+  CountShader shader;
+
+  // The area is less than 1e-2 pixel but covers the pixel center (50.5, 10.5)
+  const float d = 1.f / KURO_SUBPIXEL_ONE;
+  DrawTriangle({ MakeVertex(50.f, 10.5f - d, w, h),
+                 MakeVertex(51.f, 10.5f - d, w, h),
+                 MakeVertex(50.5f, 10.5f + d, w, h) }, &shader, buffer);
+  EXPECT_EQ(shader.count, 1);
+}
+
+TEST (triangle_test, cull) {
+  const int w = 100, h = 100;
+  // Counter-clockwise in screen space
+  std::array<FragmentContext, 3> ccw = {
+    MakeVertex(10, 10, w, h), MakeVertex(50, 10, w, h), MakeVertex(10, 50, w, h)
+  };
+  std::array<FragmentContext, 3> cw = { ccw[0], ccw[2], ccw[1] };
+  std::array<FragmentContext, 3> degenerate = {
+    ccw[0], MakeVertex(50, 50, w, h), MakeVertex(30, 30, w, h)
+  };
+  std::array<FragmentContext, 3> offscreen = {
+    MakeVertex(10.6, 10.6, w, h), MakeVertex(10.9, 10.6, w, h), MakeVertex(10.6, 10.9, w, h)
+  };
+
+  TriangleSetup setup;
+  CullState cull;
+  CullStats stats;
+  cull.cull_mode = CULL_BACK;
+  EXPECT_TRUE(SetupTriangle(ccw, w, h, setup, cull, &stats));
+  EXPECT_FALSE(SetupTriangle(cw, w, h, setup, cull, &stats));
+  EXPECT_FALSE(SetupTriangle(degenerate, w, h, setup, cull, &stats));
+  EXPECT_FALSE(SetupTriangle(offscreen, w, h, setup, cull, &stats));
+
+  cull.front_face = FRONT_FACE_CW;
+  EXPECT_FALSE(SetupTriangle(ccw, w, h, setup, cull, &stats));
+  EXPECT_TRUE(SetupTriangle(cw, w, h, setup, cull, &stats));
+
+  EXPECT_EQ(stats.setup_num, 2u);
+  EXPECT_EQ(stats.face_num, 2u);
+  EXPECT_EQ(stats.degenerate_num, 1u);
+  EXPECT_EQ(stats.offscreen_num, 1u);
+}
+
+TEST (triangle_test, depth_pre_pass) {
+  const int w = 64, h = 64;
+  FrameBuffer buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+  CountShader shader;
+
+  // Back to front: the screen and the center square
+  std::vector<TriangleSetup> setups;
+  const float squares[2][3] = { { 0, 64, -0.5 }, { 16, 48, 0.5 } };
+  for (auto const &square : squares) {
+    auto v00 = MakeVertex(square[0], square[0], w, h, square[2]);
+    auto v10 = MakeVertex(square[1], square[0], w, h, square[2]);
+    auto v01 = MakeVertex(square[0], square[1], w, h, square[2]);
+    auto v11 = MakeVertex(square[1], square[1], w, h, square[2]);
+
+    setups.emplace_back();
+    ASSERT_TRUE(SetupTriangle({ v00, v10, v11 }, w, h, setups.back()));
+    setups.emplace_back();
+    ASSERT_TRUE(SetupTriangle({ v00, v11, v01 }, w, h, setups.back()));
+  }
+
+  for (auto const &setup : setups)
+    DrawTriangle(setup, &shader, buffer, Vec2i(0, 0), Vec2i(w-1, h-1), RASTER_PASS_DEPTH);
+  EXPECT_EQ(shader.count, 0);
+
+  for (auto const &setup : setups)
+    DrawTriangle(setup, &shader, buffer, Vec2i(0, 0), Vec2i(w-1, h-1), RASTER_PASS_SHADE);
+  EXPECT_EQ(shader.count, w * h);
+}
+
+TEST (triangle_test, hiz) {
+  const int w = 100, h = 100;
+  FrameBuffer buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+  CountShader shader;
+
+  auto v00 = MakeVertex(0, 0, w, h, 0.5);
+  auto v10 = MakeVertex(w, 0, w, h, 0.5);
+  auto v01 = MakeVertex(0, h, w, h, 0.5);
+  auto v11 = MakeVertex(w, h, w, h, 0.5);
+  TriangleSetup setup;
+  ASSERT_TRUE(SetupTriangle({ v00, v10, v11 }, w, h, setup));
+  DrawTriangle(setup, &shader, buffer, Vec2i(0, 0), Vec2i(w-1, h-1), RASTER_PASS_DEPTH);
+  ASSERT_TRUE(SetupTriangle({ v00, v11, v01 }, w, h, setup));
+  DrawTriangle(setup, &shader, buffer, Vec2i(0, 0), Vec2i(w-1, h-1), RASTER_PASS_DEPTH);
+
+  // The partial blocks and tiles in the border are covered also
+  for (int ty = 0; ty < (h + KURO_HIZ_TILE_SIZE - 1) / KURO_HIZ_TILE_SIZE; ++ty)
+    for (int tx = 0; tx < (w + KURO_HIZ_TILE_SIZE - 1) / KURO_HIZ_TILE_SIZE; ++tx)
+      EXPECT_EQ(buffer.GetTileFarDepth(tx, ty), 0.5f);
+
+  // Behind the wall
+  ASSERT_TRUE(SetupTriangle({ MakeVertex(10, 10, w, h, 0.2), MakeVertex(90, 10, w, h, 0.4),
+                              MakeVertex(10, 90, w, h, 0.3) }, w, h, setup));
+  DrawTriangle(setup, &shader, buffer, Vec2i(0, 0), Vec2i(w-1, h-1));
+  EXPECT_EQ(shader.count, 0);
+}
+
+TEST (triangle_test, varying) {
+  const int w = 100, h = 100;
+  FrameBuffer buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+
+  // The varying is the screen coordinate
+  class CoorShader : public CountShader {
+   public:
+    CoorShader() { coor = varyings.Declare(VARYING_VEC2); }
+
+    uint32_t FragmentProcessBatch(FragmentPacket const &packet, FrameColor *colors) override
+    {
+      EXPECT_EQ(packet.varying_num, 2);
+      for (uint32_t mask = packet.mask; mask != 0; mask &= mask - 1) {
+        const int lane = __builtin_ctz(mask);
+        EXPECT_NEAR(packet.varyings[coor][lane], packet.x + lane + 0.5f, 1e-3f);
+        EXPECT_NEAR(packet.varyings[coor+1][lane], packet.y + 0.5f, 1e-3f);
+        ++count;
+      }
+      return 0;
+    }
+
+    int coor;
+  } shader;
+
+  const Vec2f coors[3] = { Vec2f(3, 7), Vec2f(91, 20), Vec2f(40, 88) };
+  std::array<FragmentContext, 3> triangle;
+  for (int i = 0; i < 3; ++i) {
+    triangle[i] = MakeVertex(coors[i].x(), coors[i].y(), w, h);
+    triangle[i].SetVarying(shader.coor, coors[i]);
+  }
+
+  DrawTriangle(triangle, &shader, buffer);
+  EXPECT_GT(shader.count, 0);
+}
+
+TEST (triangle_test, perspective_correct) {
+  const int w = 100, h = 100;
+  FrameBuffer buffer(w, h, FrameBuffer::IMAGE_TYPE_RGB);
+
+  /*
+   * The varying is the clip coordinate, which is linear in clip space,
+   * so varying.xy / varying.w is the NDC of the pixel center
+   */
+  class ClipShader : public CountShader {
+   public:
+    ClipShader() { clip = varyings.Declare(VARYING_VEC4); }
+
+    uint32_t FragmentProcessBatch(FragmentPacket const &packet, FrameColor *colors) override
+    {
+      for (uint32_t mask = packet.mask; mask != 0; mask &= mask - 1) {
+        const int lane = __builtin_ctz(mask);
+        const float cw = packet.varyings[clip+3][lane];
+        EXPECT_NEAR(packet.varyings[clip][lane] / cw, (packet.x + lane + 0.5f) * 2 / w - 1, 1e-4f);
+        EXPECT_NEAR(packet.varyings[clip+1][lane] / cw, (packet.y + 0.5f) * 2 / h - 1, 1e-4f);
+        ++count;
+      }
+      return 0;
+    }
+
+    int clip;
+  } shader;
+
+  std::array<FragmentContext, 3> triangle = {
+    MakeVertex(3, 7, w, h), MakeVertex(91, 20, w, h), MakeVertex(40, 88, w, h)
+  };
+  const float ws[3] = { 1, 4, 9 };
+  for (int i = 0; i < 3; ++i) {
+    triangle[i].clip_pos = triangle[i].clip_pos * ws[i];
+    triangle[i].SetVarying(shader.clip, triangle[i].clip_pos);
+  }
+
+  DrawTriangle(triangle, &shader, buffer);
+  EXPECT_GT(shader.count, 0);
+}
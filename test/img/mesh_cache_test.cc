@@ -0,0 +1,112 @@
+#include "kuro/img/mesh_cache.hh"
+#include "kuro/img/model.hh"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+static void WriteFile(char const *path, char const *contents)
+{
+  FILE *fp = fopen(path, "wb");
+  ASSERT_NE(fp, nullptr);
+  fputs(contents, fp);
+  fclose(fp);
+}
+
+static void ExpectSameModel(Model const &a, Model const &b)
+{
+  ASSERT_EQ(a.GetVertexesNum(), b.GetVertexesNum());
+  ASSERT_EQ(a.GetTexturesNum(), b.GetTexturesNum());
+  ASSERT_EQ(a.GetNormalsNum(), b.GetNormalsNum());
+  ASSERT_EQ(a.GetTrianglesNum(), b.GetTrianglesNum());
+  ASSERT_EQ(a.GetPolygonsNum(), b.GetPolygonsNum());
+  for (size_t i = 0; i < a.GetVertexesNum(); ++i)
+    for (int j = 0; j < 3; ++j)
+      EXPECT_EQ(a.GetVertex(i)[j], b.GetVertex(i)[j]);
+  for (size_t i = 0; i < a.GetTexturesNum(); ++i)
+    for (int j = 0; j < 3; ++j)
+      EXPECT_EQ(a.GetTexture(i)[j], b.GetTexture(i)[j]);
+  for (size_t i = 0; i < a.GetTrianglesNum(); ++i) {
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(a.GetTriangle(i)[j].vertex_idx, b.GetTriangle(i)[j].vertex_idx);
+      EXPECT_EQ(a.GetTriangle(i)[j].uv_idx, b.GetTriangle(i)[j].uv_idx);
+      EXPECT_EQ(a.GetTriangle(i)[j].normal_idx, b.GetTriangle(i)[j].normal_idx);
+    }
+  }
+  for (size_t i = 0; i <= a.GetPolygonsNum(); ++i)
+    EXPECT_EQ(a.polygon_offsets()[i], b.polygon_offsets()[i]);
+
+  auto const &a_buffer = a.vertex_buffer();
+  auto const &b_buffer = b.vertex_buffer();
+  ASSERT_EQ(a_buffer.GetVertexesNum(), b_buffer.GetVertexesNum());
+  ASSERT_EQ(a_buffer.GetIndexesNum(), b_buffer.GetIndexesNum());
+  EXPECT_EQ(a_buffer.indexes(), b_buffer.indexes());
+  for (size_t i = 0; i < VERTEX_STREAM_NUM * a_buffer.GetVertexesNum(); ++i)
+    EXPECT_EQ(a_buffer.GetStreams()[i], b_buffer.GetStreams()[i]);
+  for (size_t i = 0; i < a_buffer.GetVertexesNum(); ++i)
+    for (int j = 0; j < 3; ++j)
+      EXPECT_EQ(a_buffer.GetVertex(i).normal[j], b_buffer.GetVertex(i).normal[j]);
+  for (int j = 0; j < 3; ++j) {
+    EXPECT_EQ(a.GetMinBoundingCoordinate()[j], b.GetMinBoundingCoordinate()[j]);
+    EXPECT_EQ(a.GetMaxBoundingCoordinate()[j], b.GetMaxBoundingCoordinate()[j]);
+  }
+}
+
+TEST (mesh_cache_test, load) {
+  char const *path = "mesh_cache_test.obj";
+  WriteFile(path,
+            "v 1 2 3\nv -1 0.5 2\nv 0 0 0\nv 4 4 4\n"
+            "vt 0.5 0.5\nvn 0 0 1\n"
+            "f 1/1/1 2/1/1 3/1/1\nf 1//1 2//1 3//1 4//1\n");
+  const auto cache_path = GetMeshCachePath(path);
+  remove(cache_path.c_str());
+
+  Model parsed;
+  ASSERT_TRUE(parsed.ParseFrom(path));
+
+  // Parse and write the cache
+  Model model;
+  ASSERT_TRUE(model.Load(path));
+  ExpectSameModel(parsed, model);
+
+  Model cached;
+  ASSERT_TRUE(ReadMeshCache(cache_path.c_str(), path, cached));
+  ExpectSameModel(parsed, cached);
+
+  // Stale after the edit keeping the size and mtime
+  struct stat st;
+  ASSERT_EQ(stat(path, &st), 0);
+  WriteFile(path,
+            "v 1 2 3\nv -1 0.5 2\nv 0 0 0\nv 4 4 5\n"
+            "vt 0.5 0.5\nvn 0 0 1\n"
+            "f 1/1/1 2/1/1 3/1/1\nf 1//1 2//1 3//1 4//1\n");
+  const struct timespec times[2] = { st.st_atim, st.st_mtim };
+  ASSERT_EQ(utimensat(AT_FDCWD, path, times, 0), 0);
+  Model edited;
+  EXPECT_FALSE(ReadMeshCache(cache_path.c_str(), path, edited));
+
+  // Stale after the source is modified
+  WriteFile(path, "v 1 2 3\nv -1 0.5 2\nv 0 0 0\nf 1 2 3\n");
+  Model stale;
+  EXPECT_FALSE(ReadMeshCache(cache_path.c_str(), path, stale));
+  ASSERT_TRUE(stale.Load(path));
+  EXPECT_EQ(stale.GetTrianglesNum(), 1u);
+
+  // Corrupted
+  FILE *fp = fopen(cache_path.c_str(), "r+b");
+  ASSERT_NE(fp, nullptr);
+  fseek(fp, -4, SEEK_END);
+  fputc(0x7f, fp);
+  fclose(fp);
+  Model corrupted;
+  EXPECT_FALSE(ReadMeshCache(cache_path.c_str(), path, corrupted));
+  ASSERT_TRUE(corrupted.Load(path));
+  EXPECT_EQ(corrupted.GetTrianglesNum(), 1u);
+
+  remove(path);
+  remove(cache_path.c_str());
+}
@@ -0,0 +1,77 @@
+#include "kuro/img/mesh_optimizer.hh"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+/* The triangles of a grid of n x n quads in random order */
+static std::vector<uint32_t> MakeGrid(uint32_t n)
+{
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (uint32_t y = 0; y < n; ++y) {
+    for (uint32_t x = 0; x < n; ++x) {
+      const uint32_t v = y * (n + 1) + x;
+      triangles.push_back({ v, v + 1, v + n + 1 });
+      triangles.push_back({ v + n + 1, v + 1, v + n + 2 });
+    }
+  }
+  std::shuffle(triangles.begin(), triangles.end(), std::mt19937(0));
+
+  std::vector<uint32_t> indexes;
+  for (auto const &triangle : triangles)
+    indexes.insert(indexes.end(), triangle.begin(), triangle.end());
+  return indexes;
+}
+
+/* The triangles starting from the minimum index, i.e. the winding is kept */
+static std::vector<std::array<uint32_t, 3>> GetSortedTriangles(std::vector<uint32_t> const &indexes)
+{
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (size_t i = 0; i < indexes.size(); i += 3) {
+    std::array<uint32_t, 3> triangle{ indexes[i], indexes[i+1], indexes[i+2] };
+    std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+    triangles.push_back(triangle);
+  }
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+TEST (mesh_optimizer_test, acmr) {
+  // Every vertex is transformed once
+  const std::vector<uint32_t> strip = { 0, 1, 2, 2, 1, 3, 2, 3, 4 };
+  EXPECT_FLOAT_EQ(GetACMR(strip.data(), strip.size(), 5), 5.f / 3);
+
+  // Only the repeated vertex hits
+  EXPECT_FLOAT_EQ(GetACMR(strip.data(), strip.size(), 5, 1), 8.f / 3);
+}
+
+TEST (mesh_optimizer_test, optimize) {
+  const uint32_t n = 64;
+  const size_t vertex_num = (n + 1) * (n + 1);
+  const auto indexes = MakeGrid(n);
+
+  std::vector<uint32_t> optimized(indexes.size());
+  OptimizeVertexCache(optimized.data(), indexes.data(), indexes.size(), vertex_num);
+  EXPECT_EQ(GetSortedTriangles(optimized), GetSortedTriangles(indexes));
+
+  const float before = GetACMR(indexes.data(), indexes.size(), vertex_num);
+  const float after = GetACMR(optimized.data(), optimized.size(), vertex_num);
+  EXPECT_GT(before, 2.f);
+  EXPECT_LT(after, 0.8f);
+
+  // The vertexes are renumbered in the order of first use
+  auto fetched = optimized;
+  std::vector<uint32_t> remap;
+  ASSERT_EQ(OptimizeVertexFetch(fetched.data(), fetched.size(), vertex_num, remap), vertex_num);
+  uint32_t next = 0;
+  for (size_t i = 0; i < fetched.size(); ++i) {
+    ASSERT_LE(fetched[i], next);
+    if (fetched[i] == next) next++;
+    EXPECT_EQ(fetched[i], remap[optimized[i]]);
+  }
+  EXPECT_FLOAT_EQ(GetACMR(fetched.data(), fetched.size(), vertex_num), after);
+}
@@ -0,0 +1,184 @@
+#include "kuro/img/model.hh"
+
+#include <stdio.h>
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+static void WriteFile(char const *path, char const *contents)
+{
+  FILE *fp = fopen(path, "wb");
+  ASSERT_NE(fp, nullptr);
+  fputs(contents, fp);
+  fclose(fp);
+}
+
+static void ExpectVec(Vec3f const &v, float x, float y, float z)
+{
+  EXPECT_EQ(v.x(), x);
+  EXPECT_EQ(v.y(), y);
+  EXPECT_EQ(v.z(), z);
+}
+
+TEST (model_parse_test, formats) {
+  char const *path = "model_parse_test.obj";
+  WriteFile(path,
+            "# comment\r\n"
+            "v 1 2 3\r\n"
+            "v  -1.5e1\t+2 0.25 1\r\n"
+            "v 0 0 0\r\n"
+            "vt 0.5\r\n"
+            "vt 0.25 0.75 0\r\n"
+            "vn 0 0 1\r\n"
+            "vn 0 1 0\r\n"
+            "f 1 2 3\r\n"
+            "f 1/1 2/2 3/1\r\n"
+            "f 1//2 2//1 3//2 \r\n"
+            "f -3/-2/-1 -2/-1/-2 -1/-2/-1");
+
+  Model model;
+  ASSERT_TRUE(model.ParseFrom(path));
+  remove(path);
+
+  ASSERT_EQ(model.GetVertexesNum(), 3u);
+  ExpectVec(model.GetVertex(1), -15, 2, 0.25);
+  ASSERT_EQ(model.GetTexturesNum(), 2u);
+  ExpectVec(model.GetTexture(0), 0.5, 0, 0);
+  ExpectVec(model.GetTexture(1), 0.25, 0.75, 0);
+  ASSERT_EQ(model.GetNormalsNum(), 2u);
+
+  ASSERT_EQ(model.GetTrianglesNum(), 4u);
+  ASSERT_EQ(model.GetPolygonsNum(), 4u);
+  for (size_t i = 0; i < model.GetTrianglesNum(); ++i) {
+    auto const &triangle = model.GetTriangle(i);
+    for (int j = 0; j < 3; ++j)
+      EXPECT_EQ(triangle[j].vertex_idx, j);
+  }
+
+  EXPECT_EQ(model.GetTriangle(0)[0].uv_idx, -1);
+  EXPECT_EQ(model.GetTriangle(0)[0].normal_idx, -1);
+  EXPECT_EQ(model.GetTriangle(1)[1].uv_idx, 1);
+  EXPECT_EQ(model.GetTriangle(1)[1].normal_idx, -1);
+  EXPECT_EQ(model.GetTriangle(2)[0].uv_idx, -1);
+  EXPECT_EQ(model.GetTriangle(2)[0].normal_idx, 1);
+  // The negative indexes are relative to the end
+  EXPECT_EQ(model.GetTriangle(3)[0].uv_idx, 0);
+  EXPECT_EQ(model.GetTriangle(3)[0].normal_idx, 1);
+  EXPECT_EQ(model.GetTriangle(3)[1].normal_idx, 0);
+}
+
+TEST (model_parse_test, triangulate) {
+  char const *path = "model_parse_test_polygon.obj";
+  WriteFile(path,
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv -1 0 0\n"
+            "f 1 2 3 4 5\n"
+            "f 1 2\n"
+            "f -4 -3 -2 -1\n");
+
+  Model model;
+  ASSERT_TRUE(model.ParseFrom(path));
+  remove(path);
+
+  // 3 + 0 + 2 triangles
+  ASSERT_EQ(model.GetTrianglesNum(), 5u);
+  ASSERT_EQ(model.GetPolygonsNum(), 3u);
+  auto const &offsets = model.polygon_offsets();
+  EXPECT_EQ(offsets[0], 0u);
+  EXPECT_EQ(offsets[1], 3u);
+  EXPECT_EQ(offsets[2], 3u);
+  EXPECT_EQ(offsets[3], 5u);
+
+  // Fan: (0, i, i+1)
+  const int expected[5][3] = {
+    { 0, 1, 2 }, { 0, 2, 3 }, { 0, 3, 4 },
+    { 1, 2, 3 }, { 1, 3, 4 },
+  };
+  for (int i = 0; i < 5; ++i)
+    for (int j = 0; j < 3; ++j)
+      EXPECT_EQ(model.GetTriangle(i)[j].vertex_idx, expected[i][j]);
+}
+
+/*
+ * The corner of IndexFixup is the corner of triangle instead of polygon,
+ * the relative indexes of the polygon with more than 255 vertexes
+ * are resolved correctly
+ */
+TEST (model_parse_test, large_polygon) {
+  char const *path = "model_parse_test_large_polygon.obj";
+  const int n = 300;
+  FILE *fp = fopen(path, "wb");
+  ASSERT_NE(fp, nullptr);
+  for (int i = 0; i < n; ++i) fprintf(fp, "v %d 0 0\n", i);
+  fputs("f", fp);
+  for (int i = n; i > 0; --i) fprintf(fp, " -%d", i);
+  fputs("\n", fp);
+  fclose(fp);
+
+  Model model;
+  ASSERT_TRUE(model.ParseFrom(path));
+  remove(path);
+
+  ASSERT_EQ(model.GetTrianglesNum(), (size_t)n - 2);
+  for (int i = 0; i < n - 2; ++i) {
+    EXPECT_EQ(model.GetTriangle(i)[0].vertex_idx, 0);
+    EXPECT_EQ(model.GetTriangle(i)[1].vertex_idx, i + 1);
+    EXPECT_EQ(model.GetTriangle(i)[2].vertex_idx, i + 2);
+  }
+}
+
+TEST (model_parse_test, malformed) {
+  char const *path = "model_parse_test_bad.obj";
+  Model model;
+
+  WriteFile(path, "v 1 2\n");
+  EXPECT_FALSE(model.ParseFrom(path));
+  WriteFile(path, "v 1 2 3\nf 1 a 1\n");
+  EXPECT_FALSE(model.ParseFrom(path));
+  remove(path);
+
+  EXPECT_FALSE(model.ParseFrom("nonexistent.obj"));
+}
+
+TEST (model_parse_test, parallel) {
+  // Large enough to be split into chunks
+  char const *path = "model_parse_test_large.obj";
+  FILE *fp = fopen(path, "wb");
+  ASSERT_NE(fp, nullptr);
+  for (int i = 0; i < 30000; ++i) {
+    fprintf(fp, "v %d 0.5 -%d\nv %d 1.5 -%d\nv %d 2.5 -%d\nvn 0 0 1\n", i, i, i, i, i, i);
+    // The relative indexes cross the chunk boundaries
+    if (i % 2)
+      fprintf(fp, "f -3//-1 -2//-1 -1//-1\n");
+    else
+      fprintf(fp, "f %d//%d %d//%d %d//%d\n", 3*i+1, i+1, 3*i+2, i+1, 3*i+3, i+1);
+  }
+  fclose(fp);
+
+  Model serial;
+  Model parallel;
+  ASSERT_TRUE(serial.ParseFrom(path, 1));
+  ASSERT_TRUE(parallel.ParseFrom(path, 4));
+  remove(path);
+
+  ASSERT_EQ(parallel.GetVertexesNum(), 90000u);
+  ASSERT_EQ(parallel.GetTrianglesNum(), 30000u);
+  ASSERT_EQ(parallel.GetPolygonsNum(), 30000u);
+  for (size_t i = 0; i < parallel.GetVertexesNum(); ++i) {
+    ASSERT_EQ(parallel.GetVertex(i).x(), serial.GetVertex(i).x());
+  }
+  for (int i = 0; i < 30000; ++i) {
+    auto const &triangle = parallel.GetTriangle(i);
+    ASSERT_EQ(parallel.polygon_offsets()[i + 1], (uint32_t)i + 1);
+    for (int j = 0; j < 3; ++j) {
+      ASSERT_EQ(triangle[j].vertex_idx, 3*i + j);
+      ASSERT_EQ(triangle[j].normal_idx, i);
+    }
+  }
+
+  auto a = serial.GetModelMatrix();
+  auto b = parallel.GetModelMatrix();
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      EXPECT_EQ(a[i][j], b[i][j]);
+}
@@ -28,12 +28,12 @@ int main(int argc, char **argv)
     printf("(%f, %f, %f)\n", normal.x(), normal.y(), normal.z());
   }
 
-  printf("Faces: \n");
-  int face_num = 0;
-  for (auto const &face : model.faces()) {
-    printf("face[%d]: \n", face_num);
-    face_num++;
-    for (auto const &mesh : face) {
+  printf("Triangles: \n");
+  int triangle_num = 0;
+  for (auto const &triangle : model.triangles()) {
+    printf("triangle[%d]: \n", triangle_num);
+    triangle_num++;
+    for (auto const &mesh : triangle) {
       printf("%d/%d/%d ", mesh.vertex_idx, mesh.uv_idx, mesh.normal_idx);
     }
     puts("");
@@ -0,0 +1,63 @@
+#include "kuro/img/vertex_buffer.hh"
+#include "kuro/img/model.hh"
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+static Model::Mesh MakeMesh(int vertex_idx, int uv_idx, int normal_idx)
+{
+  Model::Mesh mesh;
+  mesh.vertex_idx = vertex_idx;
+  mesh.uv_idx = uv_idx;
+  mesh.normal_idx = normal_idx;
+  return mesh;
+}
+
+TEST (vertex_buffer_test, build) {
+  Model model;
+  model.vertexes() = { Vec3f(0, 0, 0), Vec3f(1, 0, 0), Vec3f(0, 1, 0), Vec3f(1, 1, 0) };
+  model.textures() = { Vec3f(0.5, 0.25, 0) };
+  model.normals() = { Vec3f(0, 0, 1), Vec3f(0, 0, -1) };
+
+  // A quad, the diagonal is shared, the last corner has another normal
+  model.triangles() = {
+    { MakeMesh(0, 0, 0), MakeMesh(1, 0, 0), MakeMesh(2, 0, 0) },
+    { MakeMesh(2, 0, 0), MakeMesh(1, 0, 0), MakeMesh(3, -1, 1) },
+    { MakeMesh(3, -1, 0), MakeMesh(2, 0, 0), MakeMesh(3, -1, 1) },
+  };
+
+  VertexBuffer buffer;
+  buffer.Build(model);
+
+  ASSERT_EQ(buffer.GetTrianglesNum(), 3u);
+  ASSERT_EQ(buffer.GetVertexesNum(), 5u);
+  EXPECT_EQ(buffer.indexes(), VertexBuffer::Indexes({ 0, 1, 2, 2, 1, 3, 4, 2, 3 }));
+
+  // The missing uv is zero
+  auto const &vertex = buffer.GetVertex(3);
+  EXPECT_EQ(vertex.pos.x(), 1);
+  EXPECT_EQ(vertex.pos.y(), 1);
+  EXPECT_EQ(vertex.normal.z(), -1);
+  EXPECT_EQ(vertex.uv.x(), 0);
+  EXPECT_EQ(buffer.GetVertex(0).uv.x(), 0.5);
+  EXPECT_EQ(buffer.GetVertex(0).uv.y(), 0.25);
+
+  // The layouts are same
+  for (size_t i = 0; i < buffer.GetVertexesNum(); ++i) {
+    auto const &v = buffer.GetVertex(i);
+    EXPECT_EQ(buffer.GetStream(VERTEX_STREAM_X)[i], v.pos.x());
+    EXPECT_EQ(buffer.GetStream(VERTEX_STREAM_Y)[i], v.pos.y());
+    EXPECT_EQ(buffer.GetStream(VERTEX_STREAM_NZ)[i], v.normal.z());
+    EXPECT_EQ(buffer.GetStream(VERTEX_STREAM_V)[i], v.uv.y());
+  }
+
+  VertexBuffer copy;
+  copy.Assign(buffer.GetStreams(), buffer.GetVertexesNum(),
+              buffer.indexes().data(), buffer.GetIndexesNum());
+  EXPECT_EQ(copy.indexes(), buffer.indexes());
+  for (size_t i = 0; i < buffer.GetVertexesNum(); ++i) {
+    EXPECT_EQ(copy.GetVertex(i).normal.z(), buffer.GetVertex(i).normal.z());
+    EXPECT_EQ(copy.GetVertex(i).uv.x(), buffer.GetVertex(i).uv.x());
+  }
+}
@@ -1,5 +1,7 @@
 #include "kuro/math/matrix.hh"
 
+#include <random>
+
 #include <gtest/gtest.h>
 
 using namespace kuro;
@@ -34,3 +36,91 @@ TEST (matrix_test, multiple2) {
 
   (a * b).Print();
 }
+
+static Matrix4x4f MakeRandomMatrix(std::mt19937 &gen)
+{
+  std::uniform_real_distribution<float> dist(-1, 1);
+  Matrix4x4f m;
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      m[i][j] = dist(gen) + (i == j ? 4 : 0);
+  return m;
+}
+
+TEST (matrix_test, inverse) {
+  std::mt19937 gen(0);
+  for (int round = 0; round < 1000; ++round) {
+    auto m = MakeRandomMatrix(gen);
+    auto identity = m * InverseScalar(m);
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j)
+        ASSERT_NEAR(identity[i][j], i == j ? 1 : 0, 1e-5f);
+
+#ifdef KURO_MATH_SSE
+    auto scalar = InverseScalar(m);
+    auto simd = InverseSSE(m);
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j)
+        ASSERT_NEAR(scalar[i][j], simd[i][j], 1e-5f);
+#endif
+  }
+}
+
+TEST (matrix_test, transpose) {
+  std::mt19937 gen(0);
+  auto m = MakeRandomMatrix(gen);
+  auto t = Transpose(m);
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      EXPECT_EQ(t[i][j], m[j][i]);
+
+  // (AB)^T = B^T A^T
+  auto n = MakeRandomMatrix(gen);
+  auto ab = Transpose(m * n);
+  auto ba = Transpose(n) * t;
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      EXPECT_NEAR(ab[i][j], ba[i][j], 1e-5f);
+}
+
+TEST (matrix_test, constexpr) {
+  // Folded at compile time, including the SSE overloads
+  constexpr Matrix4x4f m({
+    { 2, 0, 0, 1 },
+    { 0, 4, 0, 2 },
+    { 0, 0, 8, 3 },
+    { 0, 0, 0, 1 },
+  });
+  constexpr auto inv = AffineInverse(m);
+  constexpr auto identity = m * inv;
+  constexpr auto p = inv * Vec4f(3, 6, 11, 1);
+
+  static_assert(identity[0][0] == 1 && identity[0][3] == 0, "");
+  static_assert(identity[2][2] == 1 && identity[2][3] == 0, "");
+  static_assert(p.x() == 1 && p.y() == 1 && p.z() == 1 && p.w() == 1, "");
+  static_assert(Transpose(m)[3][2] == 3, "");
+  static_assert(DotProduct(Vec3f(1, 2, 3), Vec3f(4, 5, 6)) == 32, "");
+  static_assert(CrossProduct3(Vec3f(1, 0, 0), Vec3f(0, 1, 0)).z() == 1, "");
+  static_assert(GetIdentityF<4>()[1][0] == 0, "");
+}
+
+TEST (matrix_test, affine_inverse) {
+  std::mt19937 gen(0);
+  for (int round = 0; round < 100; ++round) {
+    auto m = MakeRandomMatrix(gen);
+    m[3] = { 0, 0, 0, 1 };
+
+    auto fast = AffineInverse(m);
+    auto general = InverseScalar(m);
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j)
+        ASSERT_NEAR(fast[i][j], general[i][j], 1e-5f);
+
+    // The normal keeps orthogonal to the transformed tangent
+    const Vec3f tangent(1, 2, 0);
+    const Vec3f normal(-2, 1, 5);
+    auto world_tangent = ClipVec<3>(m * EmbedVecf<4>(tangent, 0));
+    auto world_normal = GetNormalMatrix(m) * normal;
+    ASSERT_NEAR(DotProduct(world_tangent, world_normal), 0, 1e-4f);
+  }
+}
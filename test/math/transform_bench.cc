@@ -0,0 +1,86 @@
+#include "kuro/math/transform_kernel.hh"
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using namespace kuro;
+
+/*
+ * Compare the transform of point arrays:
+ * - MatrixMultiple() per point(array of structures)
+ * - TransformPoints*() over the arrays of components
+ */
+
+struct Points {
+  std::vector<Vec4f> aos;
+  std::vector<float> xs, ys, zs;
+  std::vector<float> out[4];
+  float *rows[4];
+  Matrix4x4f m;
+
+  explicit Points(size_t n)
+    : aos(n), xs(n), ys(n), zs(n)
+  {
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (size_t i = 0; i < n; ++i) {
+      xs[i] = dist(gen);
+      ys[i] = dist(gen);
+      zs[i] = dist(gen);
+      aos[i] = Vec4f(xs[i], ys[i], zs[i], 1);
+    }
+    for (int r = 0; r < 4; ++r) {
+      out[r].resize(n);
+      rows[r] = out[r].data();
+      for (int c = 0; c < 4; ++c)
+        m[r][c] = dist(gen);
+    }
+  }
+};
+
+static void BM_MatrixMultiple(benchmark::State &state)
+{
+  Points points(state.range(0));
+  std::vector<Vec4f> out(points.aos.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < points.aos.size(); ++i) {
+      out[i] = MatrixMultiple(points.m, points.aos[i]);
+    }
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_TransformPointsScalar(benchmark::State &state)
+{
+  Points points(state.range(0));
+  for (auto _ : state) {
+    TransformPointsScalar(points.m, points.xs.data(), points.ys.data(),
+                          points.zs.data(), points.xs.size(), points.rows);
+    benchmark::DoNotOptimize(points.rows[0]);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+#ifdef KURO_MATH_AVX2
+static void BM_TransformPointsAVX2(benchmark::State &state)
+{
+  Points points(state.range(0));
+  for (auto _ : state) {
+    TransformPointsAVX2(points.m, points.xs.data(), points.ys.data(),
+                        points.zs.data(), points.xs.size(), points.rows);
+    benchmark::DoNotOptimize(points.rows[0]);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_TransformPointsAVX2)->Arg(1 << 10)->Arg(1 << 16);
+#endif
+
+BENCHMARK(BM_MatrixMultiple)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK(BM_TransformPointsScalar)->Arg(1 << 10)->Arg(1 << 16);
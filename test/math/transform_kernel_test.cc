@@ -0,0 +1,63 @@
+#include "kuro/math/transform_kernel.hh"
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+TEST (transform_kernel_test, points) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-2, 2);
+
+  Matrix4x4f m;
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      m[i][j] = dist(gen);
+
+  // Not a multiple of 8, the tail is handled
+  const size_t n = 37;
+  std::vector<float> xs(n), ys(n), zs(n);
+  for (size_t i = 0; i < n; ++i) {
+    xs[i] = dist(gen);
+    ys[i] = dist(gen);
+    zs[i] = dist(gen);
+  }
+
+  std::vector<float> out[4];
+  for (auto &row : out) row.assign(n + 1, 0);
+  float *const rows[4] = { out[0].data(), out[1].data(), out[2].data(), out[3].data() };
+  TransformPoints(m, xs.data(), ys.data(), zs.data(), n, rows, 3);
+
+  for (size_t i = 0; i < n; ++i) {
+    auto expect = m * Vec4f(xs[i], ys[i], zs[i], 1);
+    for (int r = 0; r < 3; ++r)
+      ASSERT_NEAR(out[r][i], expect[r], 1e-5f);
+    // The rows out of row_num aren't written
+    ASSERT_EQ(out[3][i], 0);
+  }
+  // Out of n
+  for (int r = 0; r < 3; ++r)
+    EXPECT_EQ(out[r][n], 0);
+}
+
+TEST (transform_kernel_test, vectors) {
+  const Matrix3x3f m({
+    { 1, 2, 3 },
+    { 4, 5, 6 },
+    { 7, 8, 9 },
+  });
+  const size_t n = 11;
+  std::vector<float> xs(n, 1), ys(n, 0), zs(n, -1);
+  std::vector<float> out[3];
+  for (auto &row : out) row.resize(n);
+  float *const rows[3] = { out[0].data(), out[1].data(), out[2].data() };
+  TransformVectors(m, xs.data(), ys.data(), zs.data(), n, rows);
+
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(out[0][i], -2);
+    EXPECT_EQ(out[1][i], -2);
+    EXPECT_EQ(out[2][i], -2);
+  }
+}
@@ -27,3 +27,22 @@ TEST(vec_test, ortho)
 
   EXPECT_TRUE(!IsOrthogonal(a, b));
 }
+
+TEST(vec_test, normalize)
+{
+  Vec3f a(3, 4, 12);
+  EXPECT_FLOAT_EQ(a.len(), 13);
+  EXPECT_FLOAT_EQ(DotProduct(a, a), 169);
+
+  auto n = a.Normalize();
+  EXPECT_FLOAT_EQ(n.x(), 3.f / 13);
+  EXPECT_FLOAT_EQ(n.y(), 4.f / 13);
+  EXPECT_FLOAT_EQ(n.z(), 12.f / 13);
+
+  auto f = FastNormalize(a);
+  for (int i = 0; i < 3; ++i)
+    EXPECT_NEAR(f[i], n[i], 1e-6f);
+
+  // The padding doesn't affect the length
+  EXPECT_FLOAT_EQ(CrossProduct3(n, Vec3f(0, 0, 1)).len(), 5.f / 13);
+}
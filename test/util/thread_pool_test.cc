@@ -0,0 +1,29 @@
+#include "kuro/util/thread_pool.hh"
+
+#include <gtest/gtest.h>
+
+using namespace kuro;
+
+TEST (thread_pool_test, parallel_for) {
+  ThreadPool pool(4);
+  EXPECT_EQ(pool.GetThreadNum(), 4);
+
+  std::vector<int> counts(1000, 0);
+  for (int round = 0; round < 10; ++round) {
+    pool.ParallelFor(counts.size(), [&counts](size_t i) {
+      counts[i]++;
+    });
+  }
+
+  for (auto count : counts)
+    EXPECT_EQ(count, 10);
+}
+
+TEST (thread_pool_test, single_thread) {
+  ThreadPool pool(1);
+  EXPECT_EQ(pool.GetThreadNum(), 1);
+
+  size_t sum = 0;
+  pool.ParallelFor(100, [&sum](size_t i) { sum += i; });
+  EXPECT_EQ(sum, 4950);
+}